@@ -3,6 +3,7 @@
 
 #include "general.h"
 #include "ray.h"
+#include "ray_packet.h"
 
 class aabb { // axis-aligned bounding boxes
 
@@ -40,6 +41,13 @@ class aabb { // axis-aligned bounding boxes
             return aabb(new_x, new_y, new_z);
         }
 
+        double surface_area() const {
+            // The SAH's measure of how likely a random ray is to hit the box, 0 for an empty one
+            double dx = x.size(), dy = y.size(), dz = z.size();
+            if (dx < 0 || dy < 0 || dz < 0) return 0;
+            return 2 * (dx*dy + dy*dz + dz*dx);
+        }
+
         const interval& axis(int n) const { // util function, so it is possible to use for loops
             if (n==1) return y;
             if (n==2) return z;
@@ -48,6 +56,7 @@ class aabb { // axis-aligned bounding boxes
 
         bool hit(const ray& r, interval ray_t) const { // ray_t will be modified within the function, thus not const
             // Hit occurs, if the hits of different t intervals overlap!!!
+            RT_STAT(aabb_tests);
             for(int a=0; a<3; a++) {
                 // fmin & fmax can be used with floats, min & max are the safe choice for any object with <(>) implemented
                 auto t0 = min((axis(a).min - r.origin()[a]) / r.direction()[a], // just like the implementation in cuboid
@@ -65,6 +74,27 @@ class aabb { // axis-aligned bounding boxes
             return true;
         }
 
+        uint32_t hit_packet(const ray_packet& packet, uint32_t mask) const {
+            // Same slab test as hit(), for simd_double::width rays at a time. Returns the mask of the rays that hit the box.
+            RT_STAT_ADD(render_stats::aabb_tests, ray_packet::count(mask));
+            uint32_t result = 0;
+            for (int k = 0; k < packet.size; k += simd_double::width) {
+                if (((mask >> k) & simd_double::lane_mask) == 0) continue;
+                simd_double t_min = simd_double::load(packet.t_min + k);
+                simd_double t_max = simd_double::load(packet.t_max + k);
+                for (int a = 0; a < 3; a++) {
+                    simd_double orig = simd_double::load(packet.orig[a] + k);
+                    simd_double dir = simd_double::load(packet.dir[a] + k);
+                    simd_double ta = (axis(a).min - orig) / dir;
+                    simd_double tb = (axis(a).max - orig) / dir;
+                    t_min = max(min(ta, tb), t_min);
+                    t_max = min(max(ta, tb), t_max);
+                }
+                result |= static_cast<uint32_t>(t_min < t_max) << k;
+            }
+            return result & mask;
+        }
+
         // --> Optimized Hit-Method
         // bool hit(const ray& r, interval ray_t) const {
         //     for (int a = 0; a < 3; a++) {
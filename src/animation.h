@@ -0,0 +1,118 @@
+// Animation --> keyframed camera settings & object transforms, for rendering frame sequences
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+class animation {
+    // A track holds the values of one setting at its keyframes, in between them the value is interpolated linearly,
+    // --> before the first and after the last keyframe it stays at that keyframe's value. Values are 1 (numbers) or
+    // --> 3 (vectors) doubles. Animated objects are kept untransformed and are not part of any BVH: a frame only
+    // --> wraps them in a new rotate_y & translate, everything static (geometry, meshes, textures, BVHs) is shared
+    // --> by all frames and built once.
+
+    public:
+        int frame_count = 0; // Frames of the sequence, 0 means there are no keyframes (a still image)
+
+        // Functions
+        void add_camera_key(double frame, const string& setting, const vector<double>& value) {
+            camera_tracks[setting][frame] = value;
+        }
+
+        void add_object(const string& name, shared_ptr<hittable> base, double angle, const vec3& offset) {
+            // base: the object without its transform, angle & offset: its rotate_y & translate where no keyframe says otherwise
+            auto& o = objects[name];
+            o.base = base;
+            o.angle = angle;
+            o.offset = offset;
+        }
+
+        bool has_object(const string& name) const { return objects.count(name) != 0; }
+
+        void add_object_key(double frame, const string& name, const string& param, const vector<double>& value) {
+            // param: "rotate_y" (degrees) or "translate"
+            objects[name].tracks[param][frame] = value;
+        }
+
+        vector<pair<string, string>> camera_at(double frame) const {
+            // The keyframed camera settings at frame, as key=value settings for scene_loader::set_option
+            vector<pair<string, string>> settings;
+            for (const auto& t : camera_tracks) {
+                auto v = evaluate(t.second, frame);
+                string text;
+                for (size_t i = 0; i < v.size(); i++) text += (i > 0 ? "," : "") + format(v[i]);
+                settings.emplace_back(t.first, text);
+            }
+            return settings;
+        }
+
+        void add_objects_at(double frame, hittable_list& world) const {
+            // Adds the animated objects, transformed as they are at frame, to world
+            for (const auto& entry : objects) {
+                const animated_object& o = entry.second;
+                double angle = o.angle;
+                vec3 offset = o.offset;
+                auto r = o.tracks.find("rotate_y");
+                if (r != o.tracks.end()) angle = evaluate(r->second, frame)[0];
+                auto t = o.tracks.find("translate");
+                if (t != o.tracks.end()) {
+                    auto v = evaluate(t->second, frame);
+                    offset = vec3(v[0], v[1], v[2]);
+                }
+
+                shared_ptr<hittable> object = o.base;
+                if (angle != 0) object = make_shared<rotate_y>(object, angle);
+                if (offset.length_squared() > 0) object = make_shared<translate>(object, offset);
+                world.add(object);
+            }
+        }
+
+        void merge(const animation& other) {
+            // Adds the keyframes & objects of other (e.g. of a second scene file) to this one
+            frame_count = max(frame_count, other.frame_count);
+            for (const auto& t : other.camera_tracks)
+                for (const auto& key : t.second) camera_tracks[t.first][key.first] = key.second;
+            for (const auto& o : other.objects) objects[o.first] = o.second;
+        }
+
+    private:
+        using track = map<double, vector<double>>; // values by frame
+
+        struct animated_object {
+            shared_ptr<hittable> base;
+            double angle = 0;
+            vec3 offset;
+            map<string, track> tracks;
+        };
+
+        map<string, track> camera_tracks;
+        map<string, animated_object> objects;
+
+        static vector<double> evaluate(const track& t, double frame) {
+            auto next = t.lower_bound(frame);
+            if (next == t.begin()) return next->second;
+            if (next == t.end()) return prev(next)->second;
+            auto before = prev(next);
+            double s = (frame - before->first) / (next->first - before->first);
+            vector<double> v(before->second.size());
+            for (size_t i = 0; i < v.size(); i++) v[i] = (1 - s) * before->second[i] + s * next->second[i];
+            return v;
+        }
+
+        static string format(double x) {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%.17g", x); // parses back to the same double
+            return buffer;
+        }
+};
+
+#endif
@@ -0,0 +1,395 @@
+// Benchmark --> renders the example scenes at fixed settings and reports build time, render time, rays/s & memory
+// Usage: ./bench [--width N] [--spp N] [--depth N] [--seed N] [--threads N] [--repeat N] [--scenes a,b,...]
+//                [--bvh sah|lbvh|median] [--bvh-width 2|4|8] [--save results.tsv] [--baseline results.tsv] [--tolerance percent] [--images dir] [--verbose] [--list]
+//        ./bench --bvh-build N,N,... [--bvh sah|lbvh|median] [--bvh-width 2|4|8] [--threads N] [--repeat N] [--verbose]
+// --> --bvh-build only builds BVHs, over height fields of N triangles each, and reports the build time per triangle
+// --> & the memory the build took on top of the triangles, to show how both grow with the size of a mesh.
+// --> Build without -DRT_STATS: the counters would be part of every time measured, which ./main does not pay for.
+// --> The throughput is rays (camera, secondary & shadow rays) per second, from the ray counters that every build has
+// --> (see stats.h). Node & primitive counts per scene come from ./main built with -DRT_STATS (see the README).
+
+#include "scenes.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct bench_options {
+    int image_width = 200;
+    int samples_per_pixel = 16;
+    int max_depth = 20;
+    uint64_t seed = 1;
+    int num_threads = 0;
+    int repeat = 1;          // Runs per scene, the fastest one is reported
+    vector<string> scenes;   // Empty runs all of them
+    string save_path = "";     // Results are written there (tab separated), to serve as a later baseline
+    string baseline_path = ""; // Results to compare against
+    double tolerance = 5.0;  // Render time change (in percent) that still counts as unchanged
+    string image_dir = "";   // If set, the rendered images are written there as <scene>.png
+    bool verbose = false;    // Show the renderer's own output (progress, statistics)
+    bvh_split split = bvh_split::sah; // BVH builder of all scenes
+    int bvh_width = 2;                // and the children per BVH node
+    vector<size_t> build_sizes;       // Triangles of the --bvh-build meshes, empty renders the scenes
+
+    string settings() const {
+        return "width=" + to_string(image_width) + " spp=" + to_string(samples_per_pixel) + " depth=" + to_string(max_depth)
+            + " seed=" + to_string(seed) + " threads=" + to_string(num_threads)
+            + (split == bvh_split::median ? " bvh=median" : split == bvh_split::lbvh ? " bvh=lbvh" : "")
+            + (bvh_width != 2 ? " bvh_width=" + to_string(bvh_width) : "")
+#ifdef RT_STATS
+            + " stats" // times with the counters compiled in, not comparable to a normal build
+#endif
+            ;
+    }
+};
+
+struct bench_result {
+    string scene;
+    string status = "ok"; // "ok", "missing input" or "failed"
+    double build_ms = 0;  // Scene construction, including file loading and BVH builds
+    double bvh_ms = 0;    // BVH builds alone
+    double render_ms = 0;
+    double samples = 0;   // Camera samples, one path each
+    double rays = 0;      // Rays traced: camera, secondary & shadow rays
+    double rss_mb = 0;    // Peak resident memory of the process that ran the scene
+
+    double mrays_per_second() const { return render_ms > 0 ? rays / (1000 * render_ms) : 0; }
+};
+
+template <typename work_function>
+int run_child(work_function work, bool verbose, string& reply) {
+    // Runs work() in a child process of its own: the peak memory is that of the work alone, and a crash only loses
+    // --> this one result. The line work() returns comes back through a pipe. Returns the child's exit status, -1 if
+    // --> it did not exit normally.
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO); // the image goes there, unless it is written to image_dir
+        if (!verbose) dup2(null_fd, STDERR_FILENO);
+        string line = work();
+        if (write(fds[1], line.data(), line.size()) != static_cast<ssize_t>(line.size())) _exit(1);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) reply.append(buffer, n);
+    close(fds[0]);
+
+    int child_status = 0;
+    if (pid < 0 || waitpid(pid, &child_status, 0) < 0 || !WIFEXITED(child_status)) return -1;
+    return WEXITSTATUS(child_status);
+}
+
+bench_result run_scene(const named_scene& entry, const bench_options& options) {
+    bench_result result;
+    result.scene = entry.name;
+    string reply;
+    int status = run_child([&] {
+        // Scenes like random_spheres and final_scene draw random numbers while they are built
+        thread_sampler().seed = options.seed;
+        thread_sampler().start_pixel_sample(0, 0);
+        bvh_node::default_settings.split = options.split;
+        bvh_node::default_settings.width = options.bvh_width;
+
+        auto t0 = std::chrono::steady_clock::now();
+        scene s = entry.build();
+        auto t1 = std::chrono::steady_clock::now();
+        if (!s.complete) _exit(2);
+
+        s.preview = false; // always the full path tracer
+        s.cam.image_width = options.image_width;
+        s.cam.samples_per_pixel = options.samples_per_pixel;
+        s.cam.max_depth = options.max_depth;
+        s.cam.seed = options.seed;
+        s.cam.num_threads = options.num_threads;
+        s.cam.output_path = options.image_dir.empty() ? "-" : options.image_dir + "/" + entry.name + ".png";
+        if (!s.render()) _exit(1);
+        auto t2 = std::chrono::steady_clock::now();
+
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return to_string(std::chrono::duration<double, std::milli>(t1 - t0).count()) + " "
+            + to_string(1000 * s.bvh_seconds) + " "
+            + to_string(std::chrono::duration<double, std::milli>(t2 - t1).count()) + " "
+            + to_string(s.cam.samples_taken()) + " "
+            + to_string(render_stats::total().rays()) + " "
+            + to_string(usage.ru_maxrss / 1024.0) + "\n"; // ru_maxrss is in kilobytes on Linux
+    }, options.verbose, reply);
+
+    if (status == 2) {
+        result.status = "missing input";
+    } else if (status != 0
+               || !(istringstream(reply) >> result.build_ms >> result.bvh_ms >> result.render_ms >> result.samples
+                                         >> result.rays >> result.rss_mb)) {
+        result.status = "failed";
+    }
+    return result;
+}
+
+struct build_result {
+    bool ok = false;
+    size_t triangles = 0; // The height field's, the size rounded to a square grid
+    double bvh_ms = 0;
+    double rss_mb = 0;   // Resident memory once the triangles exist
+    double extra_mb = 0; // Peak resident memory on top of that, taken by the build
+};
+
+static double resident_mb() {
+    // Current resident memory of the process, unlike ru_maxrss not the peak
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1048576.0);
+}
+
+static hittable_list height_field(size_t triangles) {
+    // A square grid of bumpy terrain, two triangles per cell, like a scanned mesh
+    auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    hittable_list list;
+    int side = max(1, static_cast<int>(sqrt(triangles / 2.0)));
+    double cell = 1.0 / side;
+    auto height = [](double x, double z) { return 0.05 * sin(31 * x) * cos(41 * z); };
+    for (int i = 0; i < side; i++) {
+        for (int j = 0; j < side; j++) {
+            point3 a(i * cell, height(i * cell, j * cell), j * cell);
+            point3 b((i + 1) * cell, height((i + 1) * cell, j * cell), j * cell);
+            point3 c(i * cell, height(i * cell, (j + 1) * cell), (j + 1) * cell);
+            point3 d((i + 1) * cell, height((i + 1) * cell, (j + 1) * cell), (j + 1) * cell);
+            list.add(make_shared<triangle>(a, b - a, c - a, mat));
+            list.add(make_shared<triangle>(d, c - d, b - d, mat));
+        }
+    }
+    return list;
+}
+
+build_result run_build(size_t triangles, const bench_options& options) {
+    // One BVH build over a height field, in a child process like the scenes, so the peak memory is that of this build
+    build_result result;
+    string reply;
+    int status = run_child([&] {
+        hittable_list list = height_field(triangles);
+        double rss = resident_mb();
+        bvh_settings settings;
+        settings.split = options.split;
+        settings.width = options.bvh_width;
+        settings.threads = options.num_threads;
+        auto t0 = std::chrono::steady_clock::now();
+        auto tree = make_bvh(list, settings);
+        auto t1 = std::chrono::steady_clock::now();
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return to_string(list.objects.size()) + " " + to_string(std::chrono::duration<double, std::milli>(t1 - t0).count())
+            + " " + to_string(rss) + " " + to_string(usage.ru_maxrss / 1024.0 - rss) + "\n";
+    }, options.verbose, reply);
+    result.ok = status == 0
+        && (istringstream(reply) >> result.triangles >> result.bvh_ms >> result.rss_mb >> result.extra_mb);
+    return result;
+}
+
+int run_builds(const bench_options& options) {
+    // Triangles grow 10x per line: build[ms] should grow a little more than 10x (n log n), the memory about 10x
+    cout << "BVH builds: bvh=" << (options.split == bvh_split::median ? "median" : options.split == bvh_split::lbvh ? "lbvh" : "sah")
+         << " bvh_width=" << options.bvh_width << " threads=" << options.num_threads << "\n\n";
+    printf("%10s %10s %10s %11s %10s\n", "triangles", "bvh[ms]", "ns/object", "mesh[MB]", "build[MB]");
+    for (size_t size : options.build_sizes) {
+        build_result best;
+        for (int run = 0; run < options.repeat; run++) {
+            auto r = run_build(size, options);
+            if (!r.ok) {
+                best = r;
+                break;
+            }
+            if (run == 0 || r.bvh_ms < best.bvh_ms) best = r;
+        }
+        if (!best.ok) {
+            printf("%10zu failed\n", size);
+            return 1;
+        }
+        printf("%10zu %10.1f %10.0f %11.1f %10.1f\n", best.triangles, best.bvh_ms, 1e6 * best.bvh_ms / best.triangles,
+               best.rss_mb, best.extra_mb);
+        fflush(stdout);
+    }
+    return 0;
+}
+
+bool save_results(const string& path, const vector<bench_result>& results, const bench_options& options) {
+    ofstream file(path);
+    file << "# " << options.settings() << "\n";
+    file << "# scene\tbuild_ms\tbvh_ms\trender_ms\tsamples\trays\trss_mb\n";
+    for (const auto& r : results) {
+        if (r.status != "ok") continue;
+        file << r.scene << '\t' << r.build_ms << '\t' << r.bvh_ms << '\t' << r.render_ms << '\t'
+             << static_cast<uint64_t>(r.samples) << '\t' << static_cast<uint64_t>(r.rays) << '\t' << r.rss_mb << '\n';
+    }
+    return static_cast<bool>(file);
+}
+
+bool load_results(const string& path, map<string, bench_result>& results, string& settings) {
+    ifstream file(path);
+    if (!file) return false;
+    string line;
+    while (getline(file, line)) {
+        if (line.empty()) continue;
+        if (line[0] == '#') {
+            if (settings.empty()) settings = line.substr(line.find_first_not_of("# "));
+            continue;
+        }
+        bench_result r;
+        if (istringstream(line) >> r.scene >> r.build_ms >> r.bvh_ms >> r.render_ms >> r.samples >> r.rays >> r.rss_mb)
+            results[r.scene] = r;
+    }
+    return true;
+}
+
+string percent_change(double now, double before) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%+.1f%%", 100.0 * (now - before) / before);
+    return buffer;
+}
+
+int main(int argc, char** argv) {
+    bench_options options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) {
+                cerr << "Missing value for " << arg << '\n';
+                exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--width") options.image_width = stoi(value());
+        else if (arg == "--spp") options.samples_per_pixel = stoi(value());
+        else if (arg == "--depth") options.max_depth = stoi(value());
+        else if (arg == "--seed") options.seed = stoull(value());
+        else if (arg == "--threads") options.num_threads = stoi(value());
+        else if (arg == "--repeat") options.repeat = max(1, stoi(value()));
+        else if (arg == "--save") options.save_path = value();
+        else if (arg == "--baseline") options.baseline_path = value();
+        else if (arg == "--tolerance") options.tolerance = stod(value());
+        else if (arg == "--images") options.image_dir = value();
+        else if (arg == "--verbose") options.verbose = true;
+        else if (arg == "--bvh") {
+            string name = value();
+            if (name != "sah" && name != "lbvh" && name != "median") {
+                cerr << "Unknown BVH builder " << name << " (use sah, lbvh or median)\n";
+                return 1;
+            }
+            options.split = name == "sah" ? bvh_split::sah : name == "lbvh" ? bvh_split::lbvh : bvh_split::median;
+        }
+        else if (arg == "--bvh-width") {
+            options.bvh_width = stoi(value());
+            if (options.bvh_width != 2 && options.bvh_width != 4 && options.bvh_width != 8) {
+                cerr << "A BVH node has 2, 4 or 8 children\n";
+                return 1;
+            }
+        }
+        else if (arg == "--bvh-build") {
+            stringstream list(value());
+            string size;
+            while (getline(list, size, ',')) if (!size.empty()) options.build_sizes.push_back(stoull(size));
+        }
+        else if (arg == "--scenes") {
+            stringstream list(value());
+            string name;
+            while (getline(list, name, ',')) if (!name.empty()) options.scenes.push_back(name);
+        } else if (arg == "--list") {
+            for (const auto& entry : all_scenes()) cout << entry.name << '\n';
+            return 0;
+        } else {
+            cerr << "Unknown option " << arg << " (see the top of bench.cc)\n";
+            return 1;
+        }
+    }
+
+    if (!options.build_sizes.empty()) return run_builds(options);
+
+    vector<named_scene> selected;
+    for (const auto& entry : all_scenes()) {
+        if (options.scenes.empty() || find(options.scenes.begin(), options.scenes.end(), entry.name) != options.scenes.end())
+            selected.push_back(entry);
+    }
+    if (selected.size() != (options.scenes.empty() ? all_scenes().size() : options.scenes.size())) {
+        cerr << "Unknown scene name in --scenes (see --list)\n";
+        return 1;
+    }
+
+    map<string, bench_result> baseline;
+    string baseline_settings;
+    if (!options.baseline_path.empty()) {
+        if (!load_results(options.baseline_path, baseline, baseline_settings)) {
+            cerr << "Could not read baseline '" << options.baseline_path << "'\n";
+            return 1;
+        }
+        if (baseline_settings != options.settings())
+            cout << "Warning: baseline was measured with " << baseline_settings << '\n';
+    }
+
+    cout << "Settings: " << options.settings() << "\n\n";
+    printf("%-22s %10s %9s %11s %10s %9s  %s\n", "scene", "build[ms]", "bvh[ms]", "render[ms]", "Mrays/s", "RSS[MB]",
+           baseline.empty() ? "" : "render time vs baseline");
+    fflush(stdout);
+
+    vector<bench_result> results;
+    int regressions = 0;
+    for (const auto& entry : selected) {
+        bench_result best;
+        for (int run = 0; run < options.repeat; run++) {
+            auto r = run_scene(entry, options);
+            if (r.status != "ok") { best = r; break; }
+            if (run == 0 || r.render_ms < best.render_ms) {
+                r.rss_mb = max(r.rss_mb, best.rss_mb);
+                best = r;
+            }
+        }
+        results.push_back(best);
+
+        if (best.status != "ok") {
+            printf("%-22s %s\n", best.scene.c_str(), best.status.c_str());
+            fflush(stdout);
+            continue;
+        }
+        string comparison;
+        auto before = baseline.find(best.scene);
+        if (before != baseline.end() && before->second.render_ms > 0) {
+            comparison = percent_change(best.render_ms, before->second.render_ms);
+            if (best.render_ms > before->second.render_ms * (1 + options.tolerance / 100)) {
+                comparison += "  SLOWER";
+                regressions++;
+            } else if (best.render_ms < before->second.render_ms * (1 - options.tolerance / 100)) {
+                comparison += "  faster";
+            }
+        }
+        printf("%-22s %10.1f %9.1f %11.1f %10.2f %9.1f  %s\n", best.scene.c_str(), best.build_ms, best.bvh_ms,
+               best.render_ms, best.mrays_per_second(), best.rss_mb, comparison.c_str());
+        fflush(stdout);
+    }
+
+    if (!options.save_path.empty() && !save_results(options.save_path, results, options)) {
+        cerr << "Could not write results to '" << options.save_path << "'\n";
+        return 1;
+    }
+    if (regressions > 0) {
+        cout << '\n' << regressions << " scene(s) slower than the baseline by more than " << options.tolerance << "%\n";
+        return 1;
+    }
+    return 0;
+}
@@ -3,86 +3,662 @@
 #define BVH_H
 
 #include "hittable_list.h"
+#include "thread_pool.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+
+enum class bvh_split {
+    median, // random axis, split at the median object (the tutorial's builder)
+    sah,    // binned surface area heuristic
+    lbvh    // objects sorted along a Morton curve, split at the highest differing bit (fastest build)
+};
+
+struct bvh_settings {
+    bvh_split split = bvh_split::sah;
+    int width = 2;               // Children per node: 2 builds a bvh_node, 4 or 8 a wide_bvh collapsed from it (make_bvh)
+    int bins = 16;               // SAH: candidate split planes per axis (between the bins)
+    int max_leaf_size = 4;       // SAH: a leaf holds at most this many objects
+    double traversal_cost = 1.0; // SAH: cost of visiting a node, relative to testing one object
+    int threads = 0;             // SAH & LBVH builds over many objects run on this many threads, 0: one per hardware thread
+    size_t report_objects = 100000; // Builds over at least this many objects print the time of each phase, 0: never
+};
+
+template <int N> class wide_bvh;
 
 class bvh_node : public hittable {
+    // The whole tree is one array of 32 byte nodes in depth-first order: the left child of a node directly follows
+    // --> it, the node stores the index of its right child. A leaf stores the range of its objects instead, all
+    // --> leaves' objects are one array in the same order. Bounds are floats, rounded outwards so that they still
+    // --> contain the objects' double boxes. Traversal is a loop with a small stack of nodes still to visit, the
+    // --> child on the ray's side of the split is visited first, so its hits shorten the ray for the other one.
 
     public:
+        static inline bvh_settings default_settings; // Used by the list constructor (./main --bvh median|sah)
+
         // Constructors
-        bvh_node(const hittable_list& list) : bvh_node(list.objects, 0, list.objects.size()) {} 
+        bvh_node(const hittable_list& list, const bvh_settings& settings = default_settings) : objects(list.objects) {
+            build(settings);
+        }
+
+        bvh_node(const std::vector<shared_ptr<hittable>>& src_objects, size_t start, size_t end)
+            : objects(src_objects.begin() + start, src_objects.begin() + end) {
+            bvh_settings median;
+            median.split = bvh_split::median;
+            build(median);
+        }
+
+        // Functions
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            return traverse(r, ray_t, rec, 0);
+        }
+
+        void hit_packet(ray_packet& packet, uint32_t mask, hit_record* recs) const override {
+            // The whole packet walks down the tree together, as long as enough of its rays agree on the way.
+            // --> Once only a few rays are left in a node, carrying the others along is a waste, so these go on alone.
+            if (nodes.empty()) return;
+            struct entry { uint32_t index, mask; } stack[stack_size];
+            int top = 0;
+            stack[top++] = {0, mask};
+            while (top > 0) {
+                entry e = stack[--top];
+                const node& n = nodes[e.index];
+                RT_STAT_ADD(render_stats::bvh_nodes, ray_packet::count(e.mask)); // counted per ray, like hit()
+                uint32_t active = n.box().hit_packet(packet, e.mask);
+                if (active == 0)
+                    continue;
+                if (n.count > 0) {
+                    for (uint32_t i = n.index; i < n.index + n.count; i++) objects[i]->hit_packet(packet, active, recs);
+                    continue;
+                }
+                if (ray_packet::count(active) < min_packet_rays) {
+                    for (int k = 0; k < packet.size; k++) {
+                        if (!(active & (1u << k))) continue;
+                        hit_record temp_rec;
+                        if (traverse(packet.rays[k], interval(packet.t_min[k], packet.t_max[k]), temp_rec, e.index)) {
+                            recs[k] = temp_rec;
+                            packet.t_max[k] = temp_rec.t;
+                            packet.hit[k] = true;
+                        }
+                    }
+                    continue;
+                }
+                // the child on the side of the first active ray goes on top, so it is visited first
+                int first = __builtin_ctz(active);
+                bool right_first = packet.dir[n.axis][first] < 0;
+                uint32_t left = e.index + 1, right = n.index;
+                stack[top++] = {right_first ? left : right, active};
+                stack[top++] = {right_first ? right : left, active};
+            }
+        }
+
+        aabb bounding_box() const override {return bbox;}
+
+        bool random_hit() const override { return random_hits; }
+
+        size_t node_count() const { return nodes.size(); }
+
+    private:
+        template <int N> friend class wide_bvh; // collapses nodes & takes over objects
+
+        struct alignas(32) node {
+            float bounds[6];   // min x, y, z, max x, y, z
+            uint32_t index;    // Interior node: index of the right child, leaf: first of its objects
+            uint16_t count;    // Objects of a leaf, 0 for an interior node
+            uint16_t axis;     // Split axis of an interior node
+
+            aabb box() const {
+                return aabb(interval(bounds[0], bounds[3]), interval(bounds[1], bounds[4]), interval(bounds[2], bounds[5]));
+            }
+        };
+        static_assert(sizeof(node) == 32, "two nodes per cache line");
+
+        vector<node> nodes;
+        vector<shared_ptr<hittable>> objects; // in leaf order, a leaf covers [index, index + count)
+        aabb bbox;
+        bool random_hits = false; // of any object, found with the bounds
+
+        static constexpr int min_packet_rays = 4; // below this, the rays of a packet are traced one by one
+        static constexpr int stack_size = 128;
+        static constexpr int max_depth = 64;              // deeper SAH nodes are halved, so the stack can not overflow
+        static constexpr int max_leaf_objects = 65535;    // count is 16 bits
+        static constexpr size_t parallel_objects = 16384; // smaller builds & subtrees are not worth a thread of their own
+        static constexpr int max_bins = 64;
+
+        struct build_object {
+            // What the builders know of an object: they move these around, the objects themselves are put in leaf
+            // --> order once the tree is done
+            float bounds[6]; // The object's box, rounded outwards like the bounds of the nodes
+            uint32_t index;  // of the object in objects
 
-        bvh_node(const std::vector<shared_ptr<hittable>>& src_objects, size_t start, size_t end) {
-            // size_t is basically like an int that represents sizes
-            auto objects = src_objects;
+            float centroid(int axis) const { return 0.5f * (bounds[axis] + bounds[axis+3]); }
+        };
 
+        struct build_box {
+            // A float box of the builders, empty until something is added
+            float bounds[6] = {INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY};
+
+            void grow(const float* b) {
+                for (int a = 0; a < 3; a++) {
+                    bounds[a] = std::min(bounds[a], b[a]);
+                    bounds[a+3] = std::max(bounds[a+3], b[a+3]);
+                }
+            }
+
+            void grow_centroid(const build_object& object) {
+                for (int a = 0; a < 3; a++) {
+                    float c = object.centroid(a);
+                    bounds[a] = std::min(bounds[a], c);
+                    bounds[a+3] = std::max(bounds[a+3], c);
+                }
+            }
+
+            float size(int axis) const { return bounds[axis+3] - bounds[axis]; }
+
+            double surface_area() const { // like aabb::surface_area
+                double dx = size(0), dy = size(1), dz = size(2);
+                if (dx < 0 || dy < 0 || dz < 0) return 0;
+                return 2 * (dx*dy + dy*dz + dz*dx);
+            }
+        };
+
+        struct split_choice {
+            int axis = -1, bin = 0;
+            double cost = infinity;
+        };
+
+        // Traversal
+        bool traverse(const ray& r, interval ray_t, hit_record& rec, uint32_t root) const {
+            if (nodes.empty()) return false;
+            const point3& orig = r.origin();
+            vec3 inv_dir(1 / r.direction().x(), 1 / r.direction().y(), 1 / r.direction().z());
+            bool negative[3] = {inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0};
+
+            uint32_t stack[stack_size];
+            int top = 0;
+            uint32_t i = root;
+            bool hit_anything = false;
+            while (true) {
+                const node& n = nodes[i];
+                RT_STAT(bvh_nodes);
+                if (hit_box(n, orig, inv_dir, ray_t)) {
+                    if (n.count == 0) {
+                        // visit the near child next, the far one later
+                        uint32_t left = i + 1, right = n.index;
+                        if (negative[n.axis]) std::swap(left, right);
+                        stack[top++] = right;
+                        i = left;
+                        continue;
+                    }
+                    // like hittable_list::hit, the closest hit of the leaf's objects ends up in rec
+                    for (uint32_t k = n.index; k < n.index + n.count; k++) {
+                        if (objects[k]->hit(r, ray_t, rec)) {
+                            hit_anything = true;
+                            ray_t.max = rec.t;
+                        }
+                    }
+                }
+                if (top == 0) break;
+                i = stack[--top];
+            }
+            return hit_anything;
+        }
+
+        static bool hit_box(const node& n, const point3& orig, const vec3& inv_dir, interval ray_t) {
+            // The slab test of aabb::hit, with the division done once per ray
+            RT_STAT(aabb_tests);
+            for (int a = 0; a < 3; a++) {
+                double t0 = (n.bounds[a] - orig[a]) * inv_dir[a];
+                double t1 = (n.bounds[a+3] - orig[a]) * inv_dir[a];
+                if (inv_dir[a] < 0) std::swap(t0, t1);
+                if (t0 > ray_t.min) ray_t.min = t0;
+                if (t1 < ray_t.max) ray_t.max = t1;
+                if (ray_t.max <= ray_t.min)
+                    return false;
+            }
+            return true;
+        }
+
+        // Builders
+        void build(const bvh_settings& settings) {
+            // All builders work on one array of build_objects (the float boxes & the indices of the objects), that
+            // --> they partition or sort in place. The objects are put into the order of the leaves once, at the end:
+            // --> the build itself neither calls bounding_box() again, nor copies a shared_ptr.
+            // --> The median split draws its random axes in order, it always runs on the calling thread. SAH & LBVH builds
+            // --> over many objects run on a thread_pool: the object boxes, Morton codes & radix sort are split into
+            // --> chunks, the two subtrees of a large node become two tasks.
+            if (objects.empty()) return;
+            auto start = std::chrono::steady_clock::now();
+            vector<pair<const char*, double>> phases;
+            auto phase = [&](const char* name) {
+                auto now = std::chrono::steady_clock::now();
+                phases.emplace_back(name, std::chrono::duration<double, std::milli>(now - start).count());
+                start = now;
+            };
+            nodes.reserve(2 * objects.size());
+
+            int threads = 1;
+            if (settings.split != bvh_split::median && objects.size() >= parallel_objects) {
+                threads = settings.threads > 0 ? settings.threads : static_cast<int>(thread::hardware_concurrency());
+            }
+            unique_ptr<thread_pool> pool;
+            if (threads > 1) pool = make_unique<thread_pool>(threads);
+
+            size_t n = objects.size();
+            vector<build_object> items(n);
+            vector<double> median_keys; // the median split sorts by the objects' double boxes, as it always has
+            if (settings.split == bvh_split::median) median_keys.resize(3 * n);
+            mutex bbox_mutex;
+            for_chunks(pool.get(), n, [&](size_t begin, size_t end) {
+                aabb box;
+                bool random = false;
+                for (size_t i = begin; i < end; i++) {
+                    aabb object_box = objects[i]->bounding_box();
+                    random = random || objects[i]->random_hit();
+                    round_out(object_box, items[i].bounds);
+                    items[i].index = static_cast<uint32_t>(i);
+                    if (!median_keys.empty())
+                        for (int a = 0; a < 3; a++) median_keys[3*i + a] = object_box.axis(a).min;
+                    box = aabb(box, object_box);
+                }
+                lock_guard<mutex> lock(bbox_mutex);
+                bbox = aabb(bbox, box);
+                random_hits = random_hits || random;
+            });
+            phase("bounds");
+
+            if (settings.split == bvh_split::median) {
+                median_split(items, median_keys, 0, n);
+                phase("median split");
+            } else if (settings.split == bvh_split::sah) {
+                build_box box, centroids;
+                bounds_of(items, 0, n, box, centroids);
+                sah_split(items, 0, n, box, centroids, settings, 0, nodes, pool.get());
+                phase("split");
+            } else {
+                lbvh(items, settings, pool.get(), phase);
+            }
+
+            vector<shared_ptr<hittable>> sorted_objects(n);
+            for_chunks(pool.get(), n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) sorted_objects[i] = std::move(objects[items[i].index]);
+            });
+            objects.swap(sorted_objects);
+            phase("objects");
+
+            if (settings.report_objects > 0 && objects.size() >= settings.report_objects) {
+                double total = 0;
+                clog << "BVH over " << objects.size() << " objects (" << split_name(settings.split) << ", " << threads
+                     << (threads == 1 ? " thread" : " threads") << "):";
+                for (const auto& p : phases) {
+                    clog << " " << p.first << " " << static_cast<long>(p.second) << " ms,";
+                    total += p.second;
+                }
+                clog << " total " << static_cast<long>(total) << " ms\n";
+            }
+        }
+
+        static const char* split_name(bvh_split split) {
+            return split == bvh_split::median ? "median" : split == bvh_split::sah ? "sah" : "lbvh";
+        }
+
+        template <typename chunk_function>
+        static void for_chunks(thread_pool* pool, size_t n, chunk_function fn) {
+            // fn(begin, end) for chunks covering [0, n): a few per thread of pool, or all of it at once without one
+            size_t chunks = pool ? std::min(n / 4096 + 1, static_cast<size_t>(4 * pool->size())) : 1;
+            size_t size = (n + chunks - 1) / chunks;
+            if (!pool) {
+                fn(0, n);
+                return;
+            }
+            pool->parallel_for(chunks, 1, [&](size_t c) { fn(c * size, std::min(n, (c + 1) * size)); });
+        }
+
+        template <typename left_function, typename right_function>
+        void build_children(vector<node>& out, uint32_t self, size_t count, thread_pool* pool,
+                            left_function build_left, right_function build_right) {
+            // Appends the left & the right subtree of out[self] to out. Large ones are built in parallel, each into a
+            // --> vector of its own (with indices relative to it), which is then copied behind out[self].
+            if (!pool || count < parallel_objects) {
+                build_left(out, nullptr);
+                out[self].index = static_cast<uint32_t>(out.size());
+                build_right(out, nullptr);
+                return;
+            }
+            vector<node> left, right;
+            atomic<bool> left_done{false};
+            pool->submit([&] { build_left(left, pool); left_done = true; });
+            build_right(right, pool);
+            pool->wait_until([&] { return left_done.load(); });
+            append(out, left);
+            out[self].index = static_cast<uint32_t>(out.size());
+            append(out, right);
+        }
+
+        static void append(vector<node>& out, const vector<node>& subtree) {
+            uint32_t base = static_cast<uint32_t>(out.size());
+            for (node n : subtree) {
+                if (n.count == 0) n.index += base; // the right child moves along, a leaf's objects stay where they are
+                out.push_back(n);
+            }
+        }
+
+        static uint32_t add_node(vector<node>& out, const build_box& box) {
+            node n;
+            std::copy(box.bounds, box.bounds + 6, n.bounds);
+            n.index = 0;
+            n.count = 0;
+            n.axis = 0;
+            out.push_back(n);
+            return static_cast<uint32_t>(out.size() - 1);
+        }
+
+        static void round_out(const aabb& box, float* bounds) {
+            for (int a = 0; a < 3; a++) {
+                bounds[a] = round_down(box.axis(a).min);
+                bounds[a+3] = round_up(box.axis(a).max);
+            }
+        }
+
+        static void bounds_of(const vector<build_object>& items, size_t start, size_t end, build_box& box,
+                              build_box& centroids) {
+            for (size_t i = start; i < end; i++) {
+                box.grow(items[i].bounds);
+                centroids.grow_centroid(items[i]);
+            }
+        }
+
+        void median_split(vector<build_object>& items, const vector<double>& keys, size_t start, size_t end) {
             // Our strategy: choose random axix, sort objects based on that axis, split the left&right bvhs based on that object
             int axis = random_int(0,2);
-            auto comparator = (axis==0) ? box_x_compare : // choosing our comparator based on the randomly generated axis
-                (axis==1) ? box_y_compare : box_z_compare;
+            // check which object's box has the smaller min value along axis
+            auto comparator = [&keys, axis](const build_object& a, const build_object& b) {
+                return keys[3*a.index + axis] < keys[3*b.index + axis];
+            };
+
+            build_box box;
+            for (size_t i = start; i < end; i++) box.grow(items[i].bounds); // the float bounds of the union of the boxes
+            uint32_t self = add_node(nodes, box);
 
             size_t object_span = end - start; // amount of objects
+            if (object_span <= 2) {
+                // one or two objects: a leaf that tests them both
+                nodes[self].index = static_cast<uint32_t>(start);
+                nodes[self].count = static_cast<uint16_t>(object_span);
+                return;
+            }
+            // sort first!
+            // --> sort method sorts the vector based on the given comparator
+            // --> .begin() functions returns an iterator to the beginning of the sequence
+            // --> the comparisons are those of sorting the objects, so the order (and the tree) is the same
+            std::sort(items.begin()+start, items.begin()+end, comparator);
+            auto mid = start + object_span / 2;
+            median_split(items, keys, start, mid);
+            uint32_t right = static_cast<uint32_t>(nodes.size());
+            median_split(items, keys, mid, end);
+            nodes[self].index = right;
+            nodes[self].axis = static_cast<uint16_t>(axis);
+        }
+
+        void sah_split(vector<build_object>& items, size_t start, size_t end, const build_box& box,
+                       const build_box& centroids, const bvh_settings& settings, int depth, vector<node>& out,
+                       thread_pool* pool) {
+            // The cost of a node is traversal_cost + (area_left*count_left + area_right*count_right) / area, i.e. the
+            // --> expected number of object tests of a ray that hits the node (a child is hit with the probability
+            // --> area_child / area). Objects are sorted into bins by their box centers, the splits between two bins
+            // --> are the candidates. Unlike the median split, this keeps small objects away from huge ones (the
+            // --> ground sphere, the fog) and splits a mesh where its triangles thin out, not in the middle of them.
+            // --> box & centroids (the bounds of the centers) of [start, end) come from the parent, so a node reads its
+            // --> items twice: once to fill the bins, once to partition them in place and bound the children's centers.
+            size_t count = end - start;
+            uint32_t self = add_node(out, box);
 
-            if (object_span == 1) {
-                // our strategy for a single object: dupe left&right with the same object
-                left = right = objects[start];
-            } else if (object_span == 2 ) {
-                // sort first!
-                if (comparator(objects[start], objects[start+1])) {
-                    left = objects[start];
-                    right = objects[start+1];
-                } else {
-                    left = objects[start];
-                    right = objects[start+1];
+            int bins = std::clamp(settings.bins, 2, static_cast<int>(max_bins));
+            split_choice best;
+            if (count > 1 && box.surface_area() > 0 && depth < max_depth)
+                best = best_split(items, start, end, box, centroids, bins, settings);
+
+            size_t leaf_size = static_cast<size_t>(min(max(1, settings.max_leaf_size), max_leaf_objects));
+            if (count <= leaf_size && static_cast<double>(count) <= best.cost) {
+                out[self].index = static_cast<uint32_t>(start);
+                out[self].count = static_cast<uint16_t>(count);
+                return;
+            }
+
+            size_t mid = start;
+            build_box left_box, right_box, left_centroids, right_centroids;
+            if (best.axis >= 0) {
+                double scale = bin_scale(centroids, best.axis, bins);
+                for (size_t i = start; i < end; i++) {
+                    const build_object& item = items[i];
+                    if (bin_of(item, best.axis, centroids, scale, bins) <= best.bin) {
+                        left_box.grow(item.bounds);
+                        left_centroids.grow_centroid(item);
+                        std::swap(items[i], items[mid]);
+                        mid++;
+                    } else {
+                        right_box.grow(item.bounds);
+                        right_centroids.grow_centroid(item);
+                    }
                 }
             } else {
-                // sort first!
-                // --> sort method sorts the vector based on the given comparator
-                // --> .begin() functions returns an iterator to the beginning of the sequence
-                // --> it is important that the objects are not const qualified so they can be sorted!
-                std::sort(objects.begin()+start, objects.begin()+end, comparator);
-                auto mid = start + object_span / 2;
-                // we do not have to define make_shared<hittable>, since we already covered 1 and 2 object scenarios
-                left = make_shared<bvh_node>(objects, start, mid);
-                right = make_shared<bvh_node>(objects, mid, end);
+                // too many objects for a leaf, but no split to choose (all their centers coincide, or the tree is
+                // --> already max_depth deep): halve them along the longest axis
+                best.axis = centroids.size(1) > centroids.size(0) ? 1 : 0;
+                if (centroids.size(2) > centroids.size(best.axis)) best.axis = 2;
+                mid = start + count / 2;
+                bounds_of(items, start, mid, left_box, left_centroids);
+                bounds_of(items, mid, end, right_box, right_centroids);
             }
+            out[self].axis = static_cast<uint16_t>(best.axis);
+            build_children(out, self, count, pool,
+                [&](vector<node>& o, thread_pool* p) {
+                    sah_split(items, start, mid, left_box, left_centroids, settings, depth + 1, o, p);
+                },
+                [&](vector<node>& o, thread_pool* p) {
+                    sah_split(items, mid, end, right_box, right_centroids, settings, depth + 1, o, p);
+                });
         }
 
-        // Functions
-        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-            if (!bbox.hit(r, ray_t)) // aabb hit function does not have rec as parameter
-                return false;
-            bool hit_left = left->hit(r, ray_t, rec);
-            // before reaching this line, every object on the left bvh_node have been considered!
-            // --> so if there is a hit on the left node, we already filled out rec, thus we only
-            // --> need to consider if an object is hit in the right node BEFORE hitting the object in the left node
-            // --> thus we can make the ray_t interval smaller
-            bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
-            return hit_left || hit_right;
+        static split_choice best_split(const vector<build_object>& items, size_t start, size_t end, const build_box& box,
+                                       const build_box& centroids, int bins, const bvh_settings& settings) {
+            // The bins of all three axes are filled in one pass over the items, then swept from the right for the
+            // --> right sides & from the left to evaluate the splits
+            build_box bin_box[3][max_bins], right_box[max_bins];
+            size_t bin_count[3][max_bins] = {}, right_count[max_bins];
+            double scale[3];
+            for (int a = 0; a < 3; a++) scale[a] = bin_scale(centroids, a, bins);
+            for (size_t i = start; i < end; i++) {
+                const build_object& item = items[i];
+                for (int a = 0; a < 3; a++) {
+                    int b = bin_of(item, a, centroids, scale[a], bins);
+                    bin_box[a][b].grow(item.bounds);
+                    bin_count[a][b]++;
+                }
+            }
+
+            split_choice best;
+            double area = box.surface_area();
+            for (int axis = 0; axis < 3; axis++) {
+                build_box side;
+                size_t n = 0;
+                for (int b = bins - 1; b > 0; b--) {
+                    side.grow(bin_box[axis][b].bounds);
+                    n += bin_count[axis][b];
+                    right_box[b] = side;
+                    right_count[b] = n;
+                }
+                side = build_box();
+                n = 0;
+                for (int b = 0; b < bins - 1; b++) {
+                    side.grow(bin_box[axis][b].bounds);
+                    n += bin_count[axis][b];
+                    if (n == 0 || right_count[b+1] == 0) continue;
+                    double cost = settings.traversal_cost
+                        + (side.surface_area() * n + right_box[b+1].surface_area() * right_count[b+1]) / area;
+                    if (cost < best.cost) {
+                        best.cost = cost;
+                        best.axis = axis;
+                        best.bin = b;
+                    }
+                }
+            }
+            return best;
         }
 
-        aabb bounding_box() const override {return bbox;}
+        template <typename phase_function>
+        void lbvh(vector<build_object>& items, const bvh_settings& settings, thread_pool* pool, phase_function& phase) {
+            // Linear BVH: the box centers are quantized to a grid of up to 1024^3 cells and put in the order of the
+            // --> Morton curve through that grid (the bits of x, y & z interleaved), with a radix sort. Objects close on
+            // --> the curve are close in space, so a node is a range of the sorted objects, split where the highest bit
+            // --> of their codes changes. No costs are evaluated, which makes the build a lot faster than SAH, at the
+            // --> price of somewhat larger boxes.
+            size_t n = items.size();
+            build_box centroids;
+            for (const auto& item : items) centroids.grow_centroid(item);
+            vector<uint64_t> keys(n); // Morton code in the upper 32 bits, item index in the lower ones
+            for_chunks(pool, n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) keys[i] = (uint64_t(morton_code(items[i], centroids)) << 32) | i;
+            });
+            phase("morton");
 
-    private:
-        shared_ptr<hittable> left;
-        shared_ptr<hittable> right;
-        aabb bbox;
+            radix_sort(keys, pool);
+            phase("sort");
+
+            vector<uint32_t> codes(n);
+            vector<build_object> sorted_items(n);
+            for_chunks(pool, n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    codes[i] = static_cast<uint32_t>(keys[i] >> 32);
+                    sorted_items[i] = items[keys[i] & 0xffffffffu];
+                }
+            });
+            items.swap(sorted_items);
+            phase("reorder");
+
+            lbvh_split(codes, items, 0, n, settings, nodes, pool);
+            phase("hierarchy");
+        }
+
+        void lbvh_split(const vector<uint32_t>& codes, const vector<build_object>& items, size_t start, size_t end,
+                        const bvh_settings& settings, vector<node>& out, thread_pool* pool) {
+            size_t count = end - start;
+            uint32_t self = add_node(out, build_box());
+            size_t leaf_size = static_cast<size_t>(min(max(1, settings.max_leaf_size), max_leaf_objects));
+            if (count <= leaf_size) {
+                build_box box;
+                for (size_t i = start; i < end; i++) box.grow(items[i].bounds);
+                std::copy(box.bounds, box.bounds + 6, out[self].bounds);
+                out[self].index = static_cast<uint32_t>(start);
+                out[self].count = static_cast<uint16_t>(count);
+                return;
+            }
+
+            size_t mid = start + count / 2; // all codes equal: halve the range
+            uint32_t first = codes[start], last = codes[end-1];
+            if (first != last) {
+                // the codes are sorted, so the range splits where the highest bit they differ in turns from 0 to 1
+                int bit = 31 - __builtin_clz(first ^ last);
+                mid = std::partition_point(codes.begin() + start, codes.begin() + end,
+                                           [bit](uint32_t c) { return !(c & (1u << bit)); }) - codes.begin();
+                out[self].axis = static_cast<uint16_t>(2 - bit % 3); // x is the highest bit of every triple
+            }
+            build_children(out, self, count, pool,
+                [&](vector<node>& o, thread_pool* p) { lbvh_split(codes, items, start, mid, settings, o, p); },
+                [&](vector<node>& o, thread_pool* p) { lbvh_split(codes, items, mid, end, settings, o, p); });
 
-        // Box comparator functions
-        static bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis_index) {
-            // check which interval has the smaller min value
-            return a->bounding_box().axis(axis_index).min < b->bounding_box().axis(axis_index).min;
+            // the box is that of the two children
+            const node& left = out[self + 1];
+            const node& right = out[out[self].index];
+            for (int a = 0; a < 3; a++) {
+                out[self].bounds[a] = std::min(left.bounds[a], right.bounds[a]);
+                out[self].bounds[a+3] = std::max(left.bounds[a+3], right.bounds[a+3]);
+            }
+        }
+
+        static uint32_t morton_code(const build_object& item, const build_box& centroids) {
+            // The grid cells are cubes, sized by the longest side of centroids: stretching a flat axis (a terrain, a
+            // --> wall) to 1024 cells as well would make the first splits cut it into thin, overlapping slices
+            double size = max(centroids.size(0), max(centroids.size(1), centroids.size(2)));
+            uint32_t code = 0;
+            for (int a = 0; a < 3; a++) {
+                double x = size > 0 ? (item.centroid(a) - centroids.bounds[a]) / size : 0;
+                uint32_t q = static_cast<uint32_t>(std::clamp(x * 1024, 0.0, 1023.0));
+                code |= spread_bits(q) << (2 - a);
+            }
+            return code;
         }
-        static bool box_x_compare (const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-            return box_compare(a, b, 0);
+
+        static uint32_t spread_bits(uint32_t v) {
+            // The 10 bits of v, two zero bits in between each of them
+            v = (v * 0x00010001u) & 0xFF0000FFu;
+            v = (v * 0x00000101u) & 0x0F00F00Fu;
+            v = (v * 0x00000011u) & 0xC30C30C3u;
+            v = (v * 0x00000005u) & 0x49249249u;
+            return v;
         }
-        static bool box_y_compare (const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-            return box_compare(a, b, 1);
+
+        static void radix_sort(vector<uint64_t>& keys, thread_pool* pool) {
+            // LSD radix sort of the upper 32 bits, 8 bits per pass. Every chunk counts its digits, the counts turn
+            // --> into the place of each chunk's keys in the output, then the chunks are written there. Keys with
+            // --> equal digits keep their order, so the object indices (the lower bits) break the ties.
+            size_t n = keys.size();
+            vector<uint64_t> buffer(n);
+            size_t chunks = pool ? std::min(n / 4096 + 1, static_cast<size_t>(4 * pool->size())) : 1;
+            size_t size = (n + chunks - 1) / chunks;
+            vector<array<size_t, 256>> offsets(chunks);
+            auto each_chunk = [&](auto fn) {
+                if (pool) pool->parallel_for(chunks, 1, fn);
+                else for (size_t c = 0; c < chunks; c++) fn(c);
+            };
+            for (int shift = 32; shift < 64; shift += 8) {
+                each_chunk([&](size_t c) {
+                    offsets[c].fill(0);
+                    for (size_t i = c * size; i < std::min(n, (c + 1) * size); i++) offsets[c][(keys[i] >> shift) & 255]++;
+                });
+                size_t total = 0;
+                for (int d = 0; d < 256; d++) {
+                    for (size_t c = 0; c < chunks; c++) {
+                        size_t k = offsets[c][d];
+                        offsets[c][d] = total;
+                        total += k;
+                    }
+                }
+                each_chunk([&](size_t c) {
+                    for (size_t i = c * size; i < std::min(n, (c + 1) * size); i++) buffer[offsets[c][(keys[i] >> shift) & 255]++] = keys[i];
+                });
+                keys.swap(buffer);
+            }
         }
-        static bool box_z_compare (const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
-            return box_compare(a, b, 2);
+
+        static double bin_scale(const build_box& centroids, int axis, int bins) {
+            // Bins per unit along axis, 0 if all centers are in one plane: no split along it, they all go into bin 0
+            double size = centroids.size(axis);
+            return size > 0 ? bins / size : 0;
+        }
+
+        static int bin_of(const build_object& item, int axis, const build_box& centroids, double scale, int bins) {
+            double x = (item.centroid(axis) - centroids.bounds[axis]) * scale;
+            return x < bins - 1 ? static_cast<int>(x) : bins - 1;
+        }
+
+        static float round_down(double x) {
+            // The float just below x (or x itself), so a float box never ends up smaller than the double one
+            float f = static_cast<float>(x);
+            return (f > x) ? std::nextafter(f, -INFINITY) : f;
+        }
+
+        static float round_up(double x) {
+            float f = static_cast<float>(x);
+            return (f < x) ? std::nextafter(f, INFINITY) : f;
         }
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -3,13 +3,33 @@
 
 #include "general.h"
 #include "color.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "checkpoint.h"
+#include "denoiser.h"
 #include "hittable_list.h"
 #include "material.h"
+#include "thread_pool.h"
 
 #include <iostream>
 #include <chrono>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <typeinfo>
 using namespace std;
 
+struct crop_window {
+    // Pixel rectangle [x0,x1) x [y0,y1), or fractions of the image width & height if normalized
+    double x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    bool normalized = false;
+
+    bool empty() const { return x1 <= x0 || y1 <= y0; }
+};
+
 class camera {
 
     public:
@@ -17,6 +37,7 @@ class camera {
         int image_width  = 100;  // Rendered image width in pixel count
         int samples_per_pixel = 10; // Count of the random samples for each pixel (for annealing)
         int max_depth = 10;   // Maximum number of ray bounces into scene
+        int roulette_depth = 3; // Bounce from which on Russian roulette may end low-throughput paths, negative turns it off
         bool sky = false; // If sky == true, background color is ignored and initial sky implementation is used
         color background; // Scene background color
 
@@ -29,52 +50,231 @@ class camera {
         double defocus_angle = 0;  // Variation angle of rays through each pixel, 0 means perfect focus (resolution) for everything
         double focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
 
-        void render(const hittable& world) {
+        // Parallel rendering
+        int num_threads = 0; // Worker threads used for rendering, 0 means one per hardware thread
+        int tile_size = 16;  // Edge length (in pixels) of the square tiles the image is split into
+        uint64_t seed = 0;   // Seed of the per-pixel random streams, the same seed gives the same image at any thread count
+
+        // Sample pattern --> independent, stratified (jittered grid) or sobol (low discrepancy), see sampler.h
+        sample_pattern sampling = sample_pattern::independent;
+
+        // Adaptive sampling --> samples_per_pixel becomes the maximum sample count of a pixel
+        bool adaptive = false;            // Stop sampling a pixel once its estimate is accurate enough
+        int min_samples = 16;             // Samples every pixel gets, before its error is estimated at all
+        double adaptive_tolerance = 0.02; // Target standard error of a pixel's displayed (gamma corrected) luminance
+
+        // Checkpointing
+        string checkpoint_path = "";       // If set, the accumulated samples are saved there periodically (and at the end)
+        double checkpoint_interval = 300;  // Seconds between two checkpoints
+        bool resume = false;               // Continue from checkpoint_path (if it exists) instead of starting over
+
+        // Distributed rendering --> a worker takes part of the tiles and/or a range of the samples of every pixel, and
+        // --> saves its accumulated samples to partial_path instead of writing an image (see distribute.cc)
+        int part_index = 0;        // Only tiles k with k % part_count == part_index are rendered
+        int part_count = 1;
+        int sample_part = 0;       // The samples of every pixel are split into sample_part_count ranges, only range
+        int sample_part_count = 1; // --> sample_part is taken. Sample k always uses the random stream of (pixel, k), so
+                                   // --> the ranges of several workers add up to the full render.
+        string partial_path = "";  // If set, the framebuffer is saved there (checkpoint format), no image is written
+
+        // Crop window --> only the pixels inside it are traced, with the projection of the full image (so that a crop
+        // --> can be composited back into the full render)
+        crop_window crop;            // Empty traces the whole image
+        bool crop_full_size = false; // Write the full size image with the untouched pixels left black, not only the crop
+
+        // Progressive rendering
+        bool progressive = false;         // Add samples to the whole frame in passes of 1, 2, 4, ... samples per pixel
+        double progressive_interval = 0;  // Seconds between intermediate images, 0 writes one after every pass
+
+        // Wavefront rendering --> batches of paths go through the stages (generate, intersect, sort, shade) together
+        bool wavefront = false;        // Use the wavefront renderer (ignores adaptive & progressive sampling)
+        int wavefront_batch = 1 << 16; // Paths in flight per batch
+
+        // Display
+        bool ray_packets = true; // display() traces 4x4 pixel blocks as ray packets (see ray_packet.h)
+
+        // Denoising
+        bool denoise = false;    // Run the edge-aware denoiser (denoiser.h) over the final image
+        string albedo_path = ""; // If set, the first-hit albedo buffer is written there
+        string normal_path = ""; // If set, the first-hit normal buffer is written there (as -1..1 values, use .pfm)
+
+        // Light buffers --> the share of every light in the image, to change their intensities & colors afterwards
+        string light_aov_path = ""; // If set, <path>_<light>.pfm is written per emitting material (and the background),
+                                    // --> and the list of them to <path>.lights (see relight.cc)
+                                    // --> Per material on purpose: an emissive mesh stays one light, not one per triangle,
+                                    // --> so emitters that should be relit separately need separate materials
+
+        // Output
+        string output_path = "";     // Image file (.ppm, .pfm or .png), empty writes a binary ppm to stdout
+        string sample_map_path = ""; // If set, the per-pixel sample counts are written there (white = samples_per_pixel)
+        string stats_path = "";      // Built with -DRT_STATS: the counters (stats.h) are written there as JSON, else to clog
+
+        bool render(const hittable& world, const hittable& lights) {
+            // Renders with next-event estimation: every diffuse bounce also samples a direction towards lights
+            // --> (the emitting quads & spheres of world, which should be in both lists)
+            sampled_lights = &lights;
+            bool ok = render(world);
+            sampled_lights = nullptr;
+            return ok;
+        }
+
+        bool render(const hittable& world) {
+            // Returns false if the render was refused or its result could not be saved (the error is printed)
+            auto render_start = std::chrono::steady_clock::now();
+            render_stats::reset();
             initialize();
 
-            // RENDER (to ppm format)
+            film.reset(image_width, image_height);
+            light_film.clear();
+            if (!light_aov_path.empty() && (wavefront || resume || !partial_path.empty()))
+                clog << "Warning: light buffers are only collected by the tiled renderer in a single process, without resume\n";
+            if (resume && !checkpoint_path.empty()) {
+                if (checkpoint::load(checkpoint_path, film, checkpoint_settings())) {
+                    clog << "Resuming from checkpoint '" << checkpoint_path << "'\n";
+                } else if (checkpoint::exists(checkpoint_path)) {
+                    // resuming with other settings would mix incompatible samples, starting over would overwrite it
+                    clog << "ERROR: Not resuming from '" << checkpoint_path << "', remove it to start over.\n";
+                    return false;
+                } else {
+                    clog << "No checkpoint at '" << checkpoint_path << "', starting over\n";
+                }
+            }
 
-            cout << "P3\n" << image_width << " " << image_height << "\n255\n";
+            last_checkpoint = last_preview = std::chrono::steady_clock::now();
+            preview_failed = false;
 
-            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-            for(int j=0; j<image_height; ++j) {
-                //clog << "\rScanlines remaining: " << (image_height-j) << " " << flush;
-                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-                clog << "\rRendering... " << static_cast<int>(100*(j+1)/image_height) << "% "
-                    << "====== Time Elapsed = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << flush;
-                for(int i=0; i<image_width; ++i) {
-                    // color pixel_color = color(double(i)/(image_width-1), double(j)/(image_height-1), 0); // creating an easy image
-                    color pixel_color = color(0,0,0); // or simply color pixel_color(0,0,0)
-                    for(int sample=0; sample<samples_per_pixel; ++sample) {
-                        ray r = get_ray(i, j);
-                        pixel_color += ray_color(r, max_depth, world);
+            if (wavefront) {
+                render_wavefront(world);
+            } else {
+                // Progressive mode raises the sample count of the whole frame pass by pass, otherwise there is a single
+                // --> pass. A pixel that already has its samples (from the checkpoint) is skipped by sample_tile.
+                int samples = sample_range();
+                int target = progressive ? std::min(1, samples) : samples;
+                for (int pass = 1; ; pass++) {
+                    string label = progressive ? "Pass " + to_string(pass) + " (" + to_string(target) + " spp)" : "Rendering";
+                    render_tiles(label.c_str(), [&](const tile& t) {
+                        sample_tile(t, world, target);
+                    }, true);
+                    if (adaptive) {
+                        // every pixel has its first round now, the rest goes where the error is still too large
+                        freeze_first_variance(std::min(min_samples, samples));
+                        render_tiles((label + ", adaptive").c_str(), [&](const tile& t) {
+                            refine_tile(t, world, target);
+                        }, true);
                     }
-                    write_color(cout, pixel_color, samples_per_pixel);
+                    if (target >= samples) break;
+
+                    if (progressive_interval <= 0 && !output_path.empty() && partial_path.empty())
+                        preview_failed = !write_image(output_path, framed(cropped(film.resolve()))) || preview_failed;
+                    target = std::min(2*target, samples);
                 }
             }
-            clog << "\nFinished.         \n";
+
+            bool ok = !preview_failed; // the error was printed when it happened, the render went on
+            if (!checkpoint_path.empty()) ok = checkpoint::save(checkpoint_path, film, checkpoint_settings()) && ok;
+            if (!partial_path.empty()) {
+                // A worker's share only, the image (and denoising) is left to whoever merges the parts
+                ok = checkpoint::save(partial_path, film, checkpoint_settings()) && ok;
+                report_stats(render_start);
+                return ok;
+            }
+
+            // Images are cut to the crop window here, so that the denoiser only sees pixels that were traced
+            image result = cropped(film.resolve());
+            if (denoise || !albedo_path.empty() || !normal_path.empty()) {
+                image albedo, normal;
+                render_features(world, albedo, normal);
+                albedo = cropped(albedo);
+                normal = cropped(normal);
+                if (!albedo_path.empty()) ok = write_image(albedo_path, framed(albedo)) && ok;
+                if (!normal_path.empty()) ok = write_image(normal_path, framed(normal)) && ok;
+                if (denoise) {
+                    auto start = std::chrono::steady_clock::now();
+                    denoiser filter;
+                    filter.num_threads = num_threads;
+                    result = filter.run(result, albedo, normal, cropped(film.mean_variance(), 1));
+                    clog << "Denoised in " << std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start).count() << "[ms]\n";
+                }
+            }
+            report_stats(render_start);
+            ok = write_image(output_path, framed(result)) && ok;
+            if (!light_aov_path.empty()) ok = write_light_buffers() && ok;
+
+            if (adaptive) {
+                auto counts = cropped(film.sample_count, 1);
+                double total = 0;
+                for (auto n : counts) total += n;
+                clog << "Adaptive sampling: " << total / counts.size() << " samples per pixel on average (max "
+                    << samples_per_pixel << ")\n";
+            }
+            if (!sample_map_path.empty()) ok = write_image(sample_map_path, framed(cropped(film.sample_count_map(samples_per_pixel)))) && ok;
+            return ok;
         }
 
-        void display(const hittable& world) {
+        bool display(const hittable& world) {
             // Displaying the objects without computation-heavy rendering
+            auto render_start = std::chrono::steady_clock::now();
+            render_stats::reset();
             initialize();
 
-            cout << "P3\n" << image_width << " " << image_height << "\n255\n";
+            film.reset(image_width, image_height);
+            render_tiles("Displaying", [&](const tile& t) { display_tile(t, world); });
+            report_stats(render_start);
+            return write_image(output_path, framed(cropped(film.resolve())));
+        }
+
+        bool display_progressive(const hittable& world, const atomic<bool>& restart) {
+            // Interactive preview: display() at 1/8, 1/4, 1/2 and then full resolution, every pass is written to
+            // --> output_path (scaled up to the full size) as soon as it is done. Stops as soon as restart is set,
+            // --> returns whether the full resolution pass was reached. Crop windows are ignored here. A pass that can not
+            // --> be written ends the preview early (the error is printed), the next change of settings starts it over.
+            int full_width = image_width;
+            crop_window full_crop = crop;
+            crop = crop_window();
+            initialize();
+            int full_height = image_height;
 
-            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-            for(int j=0; j<image_height; ++j) {
-                //clog << "\rScanlines remaining: " << (image_height-j) << " " << flush;
-                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-                clog << "\rDisplaying... " << static_cast<int>(100*(j+1)/image_height) << "% "
-                    << "====== Time Elapsed = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << flush;
-                for(int i=0; i<image_width; ++i) {
-                    // color pixel_color = color(double(i)/(image_width-1), double(j)/(image_height-1), 0); // creating an easy image
-                    ray r = get_ray(i, j);
-                    color pixel_color = ray_color_display(r, world);
-                    write_color(cout, pixel_color, 1);
+            bool finished = true;
+            for (int scale = 8; scale >= 1 && finished; scale /= 2) {
+                auto start = std::chrono::steady_clock::now();
+                image_width = std::max(1, full_width / scale);
+                initialize(); // same view, fewer (larger) pixels
+                film.reset(image_width, image_height);
+                stop = &restart;
+                render_tiles(("Preview 1/" + to_string(scale)).c_str(), [&](const tile& t) { display_tile(t, world); });
+                stop = nullptr;
+                finished = !restart;
+                if (finished) {
+                    if (!write_image(output_path, scaled(film.resolve(), full_width, full_height))) break;
+                    clog << "Preview 1/" << scale << " written ("  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start).count() << "[ms])\n";
                 }
             }
-            clog << "\nFinished.         \n";
+            image_width = full_width;
+            crop = full_crop;
+            return finished;
+        }
+
+        uint64_t samples_taken() const {
+            // Samples in the film, i.e. camera rays traced, of the last render()
+            uint64_t n = 0;
+            for (int count : film.sample_count) n += count;
+            return n;
+        }
+
+        sample_settings checkpoint_settings() const {
+            // What checkpoints & partial renders of this camera are stamped with, see checkpoint.h
+            sample_settings s;
+            s.seed = seed;
+            s.samples_per_pixel = samples_per_pixel;
+            s.pattern = static_cast<int32_t>(sampling);
+            if (adaptive) {
+                s.adaptive = 1;
+                s.min_samples = min_samples;
+                s.adaptive_tolerance = adaptive_tolerance;
+            }
+            return s;
         }
 
     private:
@@ -90,6 +290,44 @@ class camera {
         vec3 defocus_disk_u;  // Defocus disk horizontal radius
         vec3 defocus_disk_v;  // Defocus disk vertical radius
 
+        int crop_x0, crop_y0, crop_x1, crop_y1; // Crop window in pixels (the whole image without one)
+
+        // Layout of a sample's dimensions: 0-1 pixel position, 2-3 lens, 4 time, then the intersections of the camera ray.
+        // --> Bounce b starts at camera_dimensions + b*bounce_dimensions: +0-1 scatter, +2 russian roulette, +3-5 light
+        // --> sample (then its shadow ray), and from +bounce_dimensions/2 on the intersections of the scattered ray.
+        // --> Fixed positions keep e.g. all first-bounce directions of a pixel in the same (stratified) dimensions.
+        static const uint64_t camera_dimensions = 16;
+        static const uint64_t bounce_dimensions = 32;
+
+        framebuffer film; // Accumulated pixel colors, written out once the render is done
+        const hittable* sampled_lights = nullptr; // Lights for next-event estimation, see render(world, lights)
+        struct light_sample { // what the lights contributed to a pixel, by emitting material (null: the background)
+            vector<pair<const material*, color>> parts;
+
+            void add(const material* light, const color& c) {
+                if (c.x() == 0 && c.y() == 0 && c.z() == 0) return; // e.g. a shadow ray that hit an occluder
+                for (auto& part : parts) {
+                    if (part.first == light) {
+                        part.second += c;
+                        return;
+                    }
+                }
+                parts.emplace_back(light, c);
+            }
+        };
+
+        struct light_buffer {
+            vector<color> sum; // per pixel, over all its samples
+            size_t first_pixel; // lowest pixel index the light contributed to
+        };
+
+        map<const material*, light_buffer> light_film; // only with light_aov_path
+        const atomic<bool>* stop = nullptr;       // Once set, render_tiles skips the remaining tiles (see display_progressive)
+
+        std::chrono::steady_clock::time_point last_checkpoint; // When the last checkpoint was saved
+        std::chrono::steady_clock::time_point last_preview;    // When the last intermediate image was written
+        bool preview_failed = false;                           // An intermediate image could not be written
+
         // IMPORTANT
         // --> viewport is just defines the area we are looking at! It is not a screen-like object!
 
@@ -138,19 +376,487 @@ class camera {
             auto defocus_radius = focus_dist * tan(degrees_to_radians(defocus_angle / 2));
             defocus_disk_u = u * defocus_radius;
             defocus_disk_v = v * defocus_radius;
+
+            // Crop window, normalized ones are rounded outwards to whole pixels
+            crop_x0 = 0; crop_y0 = 0;
+            crop_x1 = image_width; crop_y1 = image_height;
+            if (!crop.empty()) {
+                double sx = crop.normalized ? image_width : 1, sy = crop.normalized ? image_height : 1;
+                crop_x0 = std::clamp(static_cast<int>(floor(crop.x0 * sx)), 0, image_width);
+                crop_y0 = std::clamp(static_cast<int>(floor(crop.y0 * sy)), 0, image_height);
+                crop_x1 = std::clamp(static_cast<int>(ceil(crop.x1 * sx)), crop_x0, image_width);
+                crop_y1 = std::clamp(static_cast<int>(ceil(crop.y1 * sy)), crop_y0, image_height);
+                if (crop_x1 == crop_x0 || crop_y1 == crop_y0) clog << "Warning: the crop window lies outside the image\n";
+            }
+        }
+
+        struct tile { int x0, y0, x1, y1; }; // pixel rectangle [x0,x1) x [y0,y1)
+
+        template <typename tile_function>
+        void render_tiles(const char* label, tile_function render_tile, bool snapshots = false) {
+            // Splits the image into tiles and lets the thread pool work them off. Every pixel is written
+            // --> by exactly one task, so the framebuffer needs no locking.
+            // --> render_tile(t) adds the samples of all pixels in tile t to the film
+            // --> With snapshots, checkpoints & timed intermediate images are written while the tiles are worked off.
+
+            vector<tile> tiles;
+            int ts = (tile_size < 1) ? 1 : tile_size;
+            for (int y0 = 0; y0 < image_height; y0 += ts) {
+                for (int x0 = 0; x0 < image_width; x0 += ts) {
+                    if (!in_part(x0, y0)) continue;
+                    // The grid is the one of the full image, tiles on the edge of the crop window are cut to it
+                    tile t = {std::max(x0, crop_x0), std::max(y0, crop_y0),
+                              std::min({x0 + ts, image_width, crop_x1}), std::min({y0 + ts, image_height, crop_y1})};
+                    if (t.x0 < t.x1 && t.y0 < t.y1) tiles.push_back(t);
+                }
+            }
+
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            atomic<int> tiles_done{0};
+            int last_percent = -1;
+            mutex progress_mutex;
+
+            // Snapshots must only contain finished tiles (a tile in progress has some of its samples, and is being
+            // --> written to), the unfinished ones are taken in the state they had when this sweep started.
+            bool save_checkpoints = snapshots && !checkpoint_path.empty();
+            bool write_previews = snapshots && progressive && progressive_interval > 0 && !output_path.empty();
+            framebuffer sweep_start = (save_checkpoints || write_previews) ? film : framebuffer();
+            vector<char> tile_finished(tiles.size(), 0);
+            auto snapshot = [&] {
+                framebuffer fb = sweep_start;
+                for (size_t f = 0; f < tiles.size(); f++)
+                    if (tile_finished[f]) copy_tile(film, fb, tiles[f]);
+                return fb;
+            };
+
+            sampler caller_sampler = thread_sampler(); // the caller helps out in pool.wait(), keep its stream untouched
+            thread_pool pool(num_threads);
+            clog << label << " with " << pool.size() << " threads\n";
+            for (size_t k = 0; k < tiles.size(); k++) {
+                pool.submit([&, k] {
+                    if (stop && *stop) return;
+                    const tile& t = tiles[k];
+                    configure_sampler();
+                    render_tile(t);
+
+                    int percent = static_cast<int>(100 * ++tiles_done / tiles.size());
+                    lock_guard<mutex> lock(progress_mutex);
+                    tile_finished[k] = 1;
+                    auto now = std::chrono::steady_clock::now();
+                    if (save_checkpoints && std::chrono::duration<double>(now - last_checkpoint).count() >= checkpoint_interval) {
+                        checkpoint::save(checkpoint_path, snapshot(), checkpoint_settings());
+                        last_checkpoint = now;
+                    }
+                    if (write_previews && std::chrono::duration<double>(now - last_preview).count() >= progressive_interval) {
+                        preview_failed = !write_image(output_path, framed(cropped(snapshot().resolve()))) || preview_failed;
+                        last_preview = now;
+                    }
+                    if (percent <= last_percent) return;
+                    last_percent = percent;
+                    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                    clog << "\r" << label << "... " << percent << "% "
+                        << "====== Time Elapsed = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << flush;
+                });
+            }
+            pool.wait();
+            thread_sampler() = caller_sampler;
+            clog << "\nFinished.         \n";
+        }
+
+        struct path_state { // everything a path in flight needs between the wavefront stages
+            ray r;
+            hit_record rec;
+            color throughput;
+            color radiance;
+            double scatter_pdf;
+            sampler rng;   // the path's random stream, swapped in & out of the thread whichever thread works on it
+            size_t pixel;
+            int sample;
+            bool hit;
+        };
+
+        void render_wavefront(const hittable& world) {
+            // Instead of following one path from the camera to its end, a whole batch of paths is advanced one stage
+            // --> at a time: generate camera rays, intersect all of them with the world, sort the hits by material, and
+            // --> shade each material group in one go. Each stage runs its own code over many rays in a tight loop,
+            // --> instead of alternating BVH traversal, Perlin noise, image lookups, ... for every single ray.
+            // --> Every path uses exactly the random numbers it would use in ray_color, and the results are accumulated
+            // --> in (pixel, sample) order, so the image is identical to the one of the tiled renderer.
+            using clock = std::chrono::steady_clock;
+            double t_generate = 0, t_intersect = 0, t_sort = 0, t_shade = 0, t_accumulate = 0;
+            size_t camera_rays = 0, secondary_rays = 0;
+            auto seconds = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double>(b - a).count(); };
+
+            sampler caller_sampler = thread_sampler();
+            thread_pool pool(num_threads);
+            const size_t grain = 256;
+            clog << "Wavefront rendering with " << pool.size() << " threads, " << wavefront_batch << " paths per batch\n";
+
+            size_t n_pixels = film.sample_count.size();
+            int samples = sample_range();
+            size_t cursor_pixel = 0;
+            int cursor_sample = n_pixels > 0 ? film.sample_count[0] : 0;
+            vector<path_state> paths;
+            vector<uint32_t> active, order;
+            vector<pair<size_t, uintptr_t>> keys;
+            auto begin = clock::now();
+            int last_percent = -1;
+
+            while (cursor_pixel < n_pixels) {
+                // Stage 1: camera rays for the next (pixel, sample) pairs
+                auto t0 = clock::now();
+                paths.clear();
+                while (paths.size() < static_cast<size_t>(std::max(wavefront_batch, 1)) && cursor_pixel < n_pixels) {
+                    int i = static_cast<int>(cursor_pixel % image_width), j = static_cast<int>(cursor_pixel / image_width);
+                    if (cursor_sample >= samples || !in_part(i, j) || i < crop_x0 || i >= crop_x1 || j < crop_y0 || j >= crop_y1) {
+                        if (++cursor_pixel < n_pixels) cursor_sample = film.sample_count[cursor_pixel];
+                        continue;
+                    }
+                    path_state p;
+                    p.pixel = cursor_pixel;
+                    p.sample = cursor_sample++;
+                    paths.push_back(p);
+                }
+                pool.parallel_for(paths.size(), grain, [&](size_t k) {
+                    auto& p = paths[k];
+                    configure_sampler();
+                    p.r = get_ray(static_cast<int>(p.pixel % image_width), static_cast<int>(p.pixel / image_width), first_sample() + p.sample);
+                    p.rng = thread_sampler();
+                    p.throughput = color(1,1,1);
+                    p.radiance = color(0,0,0);
+                    p.scatter_pdf = 0;
+                });
+                camera_rays += paths.size();
+                active.resize(paths.size());
+                for (size_t k = 0; k < paths.size(); k++) active[k] = static_cast<uint32_t>(k);
+                auto t1 = clock::now();
+                t_generate += seconds(t0, t1);
+
+                for (int bounce = 0; bounce < max_depth && !active.empty(); bounce++) {
+                    // Stage 2: intersect every active path (constant_medium::hit draws random numbers, hence the swap)
+                    auto t2 = clock::now();
+                    pool.parallel_for(active.size(), grain, [&](size_t k) {
+                        auto& p = paths[active[k]];
+                        thread_sampler() = p.rng;
+                        p.hit = world.hit(p.r, interval(0.001, infinity), p.rec);
+                        p.rng = thread_sampler();
+                    });
+                    if (bounce > 0) secondary_rays += active.size();
+                    auto t3 = clock::now();
+                    t_intersect += seconds(t2, t3);
+
+                    // Stage 3: sort by material type, then material instance (misses first)
+                    keys.resize(paths.size());
+                    for (auto k : active) {
+                        const auto& p = paths[k];
+                        keys[k] = p.hit ? make_pair(typeid(*p.rec.mat).hash_code() | 1, reinterpret_cast<uintptr_t>(p.rec.mat))
+                                        : make_pair(size_t(0), uintptr_t(0));
+                    }
+                    order = active;
+                    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+                    auto t4 = clock::now();
+                    t_sort += seconds(t3, t4);
+
+                    // Stage 4: shade the groups, paths that are still alive go on to the next bounce
+                    vector<char> alive(paths.size(), 0);
+                    pool.parallel_for(order.size(), grain, [&](size_t k) {
+                        auto& p = paths[order[k]];
+                        if (!p.hit) {
+                            p.radiance += p.throughput * background_color(p.r);
+                            return;
+                        }
+                        thread_sampler() = p.rng;
+                        ray scattered;
+                        if (path_vertex(p.r, p.rec, bounce, world, p.throughput, p.radiance, p.scatter_pdf, scattered)) {
+                            p.r = scattered;
+                            alive[order[k]] = 1;
+                        }
+                        p.rng = thread_sampler();
+                    });
+                    active.clear();
+                    for (auto k : order)
+                        if (alive[k]) active.push_back(k);
+                    t_shade += seconds(t4, clock::now());
+                }
+
+                // Stage 5: accumulate in (pixel, sample) order
+                auto t5 = clock::now();
+                for (const auto& p : paths) film.add_sample(p.pixel, p.radiance);
+                t_accumulate += seconds(t5, clock::now());
+
+                int percent = static_cast<int>(100*cursor_pixel/n_pixels);
+                if (percent != last_percent) {
+                    last_percent = percent;
+                    clog << "\rWavefront... " << percent << "% ====== Time Elapsed = "
+                        << std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - begin).count() << "[ms]" << flush;
+                }
+            }
+            thread_sampler() = caller_sampler;
+
+            double total = t_generate + t_intersect + t_sort + t_shade + t_accumulate;
+            auto row = [&](const char* stage, double t) {
+                clog << "  " << stage << string(12 - strlen(stage), ' ') << static_cast<long>(1000*t) << " ms ("
+                    << static_cast<int>(total > 0 ? 100*t/total : 0) << "%)\n";
+            };
+            clog << "\nFinished.         \n"
+                << "Wavefront stage timings (" << camera_rays << " camera rays, " << secondary_rays << " secondary rays):\n";
+            row("generate", t_generate);
+            row("intersect", t_intersect);
+            row("sort", t_sort);
+            row("shade", t_shade);
+            row("accumulate", t_accumulate);
+        }
+
+        void render_features(const hittable& world, image& albedo, image& normal) {
+            // Albedo & normal at the first hit, averaged over the first (up to 8) camera rays of every pixel.
+            // --> These are noise free (no light transport involved), which is what guides the denoiser.
+            albedo = image(image_width, image_height);
+            normal = image(image_width, image_height);
+            int n = std::max(1, std::min(samples_per_pixel, 8));
+            render_tiles("Features", [&](const tile& t) {
+                for (int j = t.y0; j < t.y1; ++j) {
+                    for (int i = t.x0; i < t.x1; ++i) {
+                        color a(0,0,0), nn(0,0,0);
+                        for (int sample = 0; sample < n; sample++) {
+                            ray r = get_ray(i, j, sample);
+                            hit_record rec;
+                            if (world.hit(r, interval(0.001, infinity), rec)) {
+                                a += rec.mat->surface_albedo(rec);
+                                nn += rec.normal;
+                            } else {
+                                a += color(1,1,1); // background: nothing to demodulate
+                            }
+                        }
+                        for (int c = 0; c < 3; c++) {
+                            albedo.pixel(i, j)[c] = static_cast<float>(a[c] / n);
+                            normal.pixel(i, j)[c] = static_cast<float>(nn[c] / n);
+                        }
+                    }
+                }
+            });
+        }
+
+        int first_sample() const {
+            // Index of the first sample of sample_part, the film counts the samples from there on
+            int parts = std::max(sample_part_count, 1);
+            return static_cast<int>(static_cast<long long>(samples_per_pixel) * sample_part / parts);
+        }
+
+        int sample_range() const {
+            // Samples per pixel this render takes (all of them, unless it is one worker's share)
+            int parts = std::max(sample_part_count, 1);
+            return static_cast<int>(static_cast<long long>(samples_per_pixel) * (sample_part + 1) / parts) - first_sample();
+        }
+
+        bool in_part(int i, int j) const {
+            // Whether pixel i,j lies in one of the tiles of this worker
+            if (part_count <= 1) return true;
+            int ts = (tile_size < 1) ? 1 : tile_size;
+            int tiles_x = (image_width + ts - 1) / ts;
+            return ((j / ts) * tiles_x + i / ts) % part_count == part_index;
+        }
+
+        bool cropping() const {
+            return crop_x0 > 0 || crop_y0 > 0 || crop_x1 < image_width || crop_y1 < image_height;
+        }
+
+        template <typename T>
+        vector<T> cropped(const vector<T>& full, int channels) const {
+            // The crop window's rows of a per-pixel buffer with channels values per pixel
+            if (!cropping()) return full;
+            vector<T> region;
+            region.reserve(static_cast<size_t>(crop_x1 - crop_x0) * (crop_y1 - crop_y0) * channels);
+            for (int j = crop_y0; j < crop_y1; j++) {
+                auto row = full.begin() + (static_cast<size_t>(j) * image_width + crop_x0) * channels;
+                region.insert(region.end(), row, row + static_cast<size_t>(crop_x1 - crop_x0) * channels);
+            }
+            return region;
+        }
+
+        image cropped(const image& full) const {
+            image region(crop_x1 - crop_x0, crop_y1 - crop_y0);
+            region.rgb = cropped(full.rgb, 3);
+            return region;
+        }
+
+        image framed(const image& region) const {
+            // What is written out: the crop itself, or with crop_full_size the full image with the crop in its place
+            if (!crop_full_size || !cropping()) return region;
+            image full(image_width, image_height);
+            for (int j = 0; j < region.height; j++)
+                std::copy(region.pixel(0, j), region.pixel(0, j) + 3 * region.width, full.pixel(crop_x0, crop_y0 + j));
+            return full;
+        }
+
+        void configure_sampler() const {
+            auto& rng = thread_sampler();
+            rng.seed = seed;
+            rng.pattern = sampling;
+            rng.samples_per_pixel = samples_per_pixel;
+        }
+
+        static void copy_tile(const framebuffer& from, framebuffer& to, const tile& t) {
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    auto idx = from.index(i, j);
+                    to.color_sum[idx] = from.color_sum[idx];
+                    to.luminance_sq_sum[idx] = from.luminance_sq_sum[idx];
+                    to.sample_count[idx] = from.sample_count[idx];
+                    to.converged[idx] = from.converged[idx];
+                    to.first_variance[idx] = from.first_variance[idx];
+                }
+            }
+        }
+
+        void sample_tile(const tile& t, const hittable& world, int max_samples) {
+            // Brings every pixel of the tile up to max_samples samples, in adaptive mode only up to min_samples (the
+            // --> first round, see refine_tile for the rest)
+            int first_round = adaptive ? std::min(min_samples, max_samples) : max_samples;
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    if (film.converged[film.index(i, j)]) continue;
+                    sample_pixel(i, j, world, first_round);
+                }
+            }
+        }
+
+        void freeze_first_variance(int first_round) {
+            // Runs between the first round & refine_tile, on the calling thread: the variance of every pixel that has
+            // --> its first round is kept in film.first_variance. The neighbours of a pixel are read from there, so a
+            // --> tile never reads what another thread is writing, and a pixel on the edge of its tile sees the same
+            // --> neighbourhood as any other pixel. A checkpoint keeps these values, a resume decides like the
+            // --> uninterrupted render.
+            for (size_t idx = 0; idx < film.sample_count.size(); idx++) {
+                if (film.first_variance[idx] < 0 && film.sample_count[idx] >= first_round)
+                    film.first_variance[idx] = static_cast<float>(film.luminance_variance(idx));
+            }
+        }
+
+        void refine_tile(const tile& t, const hittable& world, int max_samples) {
+            // The tile is refined in rounds, only pixels whose estimate is not yet accurate enough get more samples
+            // --> (25% more per round), up to max_samples
+            vector<pair<int,int>> active;
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    auto idx = film.index(i, j);
+                    if (!film.converged[idx] && film.first_variance[idx] >= 0 && film.sample_count[idx] < max_samples)
+                        active.push_back({i, j});
+                }
+            }
+
+            while (!active.empty()) {
+                vector<pair<int,int>> remaining;
+                for (const auto& [i, j] : active) {
+                    if (pixel_converged(i, j)) film.converged[film.index(i, j)] = 1;
+                    else remaining.push_back({i, j});
+                }
+                active.clear();
+                for (const auto& [i, j] : remaining) {
+                    int n = film.sample_count[film.index(i, j)];
+                    sample_pixel(i, j, world, std::min(n + std::max(4, n/4), max_samples));
+                    if (film.sample_count[film.index(i, j)] < max_samples) active.push_back({i, j});
+                }
+            }
+        }
+
+        bool pixel_converged(int i, int j) const {
+            // A pixel is done once the standard error of its mean luminance, in the gamma corrected & clamped values
+            // --> that end up in the image, is below adaptive_tolerance: dark pixels need a smaller error in linear
+            // --> terms than bright ones, pixels far above white none at all. The variance is the largest one of the
+            // --> pixel itself and the first rounds of its 3x3 neighbourhood: a pixel that just has not found the small
+            // --> light source yet has zero variance on its own, but its noisy neighbours give it away.
+            auto idx = film.index(i, j);
+            double variance = film.luminance_variance(idx);
+            for (int y = std::max(j-1, 0); y <= std::min(j+1, image_height-1); ++y)
+                for (int x = std::max(i-1, 0); x <= std::min(i+1, image_width-1); ++x)
+                    variance = fmax(variance, film.first_variance[film.index(x, y)]); // -1: not sampled (other part)
+
+            auto mean = film.mean_luminance(idx);
+            auto std_error = sqrt(variance / film.sample_count[idx]);
+            auto display = [](double l) { return linear_to_gamma(std::clamp(l, 0.0, 1.0)); };
+            return 0.5 * (display(mean + std_error) - display(mean - std_error)) <= adaptive_tolerance;
+        }
+
+        void sample_pixel(int i, int j, const hittable& world, int target_samples) {
+            // Adds samples to pixel i,j until it has target_samples of them. Sample k always uses the random
+            // --> stream of (pixel, k), no matter in how many rounds the samples are taken.
+            auto idx = film.index(i, j);
+            int first = first_sample();
+            light_sample pixel_lights; // summed over the samples
+            light_sample* lights = light_aov_path.empty() ? nullptr : &pixel_lights;
+            for (int sample = film.sample_count[idx]; sample < target_samples; ++sample) {
+                ray r = get_ray(i, j, first + sample);
+                film.add_sample(idx, ray_color(r, max_depth, world, lights));
+            }
+            if (lights) add_light_sample(idx, pixel_lights);
+        }
+
+        void add_light_sample(size_t idx, const light_sample& lights) {
+            // Pixels are sampled by many threads, so adding to light_film takes a lock (once per pixel, not per sample)
+            static mutex light_mutex;
+            lock_guard<mutex> lock(light_mutex);
+            for (const auto& part : lights.parts) {
+                auto& buffer = light_film[part.first];
+                if (buffer.sum.empty()) {
+                    buffer.sum.assign(film.sample_count.size(), color(0,0,0));
+                    buffer.first_pixel = idx;
+                }
+                buffer.sum[idx] += part.second;
+                buffer.first_pixel = std::min(buffer.first_pixel, idx);
+            }
+        }
+
+        bool write_light_buffers() const {
+            // One image per light, divided by the sample counts like the image itself, so that they add up to it.
+            // --> Lights are named after their material (see material::name), or numbered in the order of the first
+            // --> pixel they show up in, which does not depend on the threads.
+            vector<pair<size_t, const material*>> order;
+            for (const auto& entry : light_film) order.emplace_back(entry.second.first_pixel, entry.first);
+            std::sort(order.begin(), order.end());
+
+            ofstream list(light_aov_path + ".lights");
+            bool ok = true;
+            int count = 0;
+            map<string, int> used;
+            for (const auto& [first_pixel, light] : order) {
+                string name = light == nullptr ? "background" : (light->name.empty() ? "light" + to_string(++count) : light->name);
+                if (used[name]++ > 0) name += "_" + to_string(used[name]);
+                string path = light_aov_path + "_" + name + ".pfm";
+
+                const auto& sum = light_film.at(light).sum;
+                image img(image_width, image_height);
+                for (size_t idx = 0; idx < sum.size(); idx++) {
+                    auto scale = (film.sample_count[idx] > 0) ? 1.0 / film.sample_count[idx] : 0.0;
+                    for (int c = 0; c < 3; c++) img.rgb[3*idx + c] = static_cast<float>(sum[idx][c] * scale);
+                }
+                ok = write_image(path, framed(cropped(img))) && ok;
+                list << name << ' ' << path << '\n';
+            }
+            if (!list) {
+                clog << "ERROR: Could not write the list of light buffers '" << light_aov_path << ".lights'.\n";
+                return false;
+            }
+            clog << "Wrote " << order.size() << " light buffers (" << light_aov_path << ".lights)\n";
+            return ok;
         }
 
-        ray get_ray(int i, int j) {
+        ray get_ray(int i, int j, int sample) const {
             // Get a randomly sampled camera ray for the pixel at location i,j.
+            // --> every random number of this sample (also the ones drawn by the materials further down the path)
+            // --> comes from the stream keyed by (pixel, sample)
+            RT_RAY(camera_rays);
+            thread_sampler().start_pixel_sample(static_cast<uint64_t>(j) * image_width + i, sample);
 
             auto pixel_center = pixel00_loc + (i*pixel_delta_u) + (j*pixel_delta_v);
-            auto pixel_sample = pixel_center + pixel_sample_square();
+            auto pixel_sample = pixel_center + pixel_sample_square(); // dimensions 0 & 1
 
             // auto ray_origin = center;
-            auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample(); // originate from anywhere on defocus disk
+            thread_sampler().start_dimension(2);
+            auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample(); // originate from anywhere on defocus disk (2 & 3)
             // IMPORTANT: Objects on the focus plane (where the viewport lies) are gonna look focused, since the rays are
             // --> sent directly to them, not mattering where they originate from!
             auto ray_direction = pixel_sample - ray_origin; // ray going from camera to image
+            thread_sampler().start_dimension(4);
             double ray_time = random_double(); // our time frame time-interval is [0,1]
 
             return ray(ray_origin, ray_direction, ray_time);
@@ -170,57 +876,203 @@ class camera {
             return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
         }
 
-        color ray_color(const ray& r, int depth, const hittable& world) const { // world is defined to be hittable, but since hittable_list
-            // --> extends hittable it can also be hittable_list
-            hit_record rec;
+        color ray_color(const ray& camera_ray, int depth, const hittable& world, light_sample* lights = nullptr) const { // world is defined to be hittable, but since
+            // --> hittable_list extends hittable it can also be hittable_list
+            // Iterative path tracing: instead of recursing once per bounce (a stack frame & hit_record each), the loop carries
+            // --> the path throughput, i.e. the product of all attenuations so far. Light found at a bounce is weighted with it.
+            color radiance(0,0,0);
+            color throughput(1,1,1);
+            double scatter_pdf = 0; // see path_vertex
+            ray r = camera_ray;
 
             // If we've exceeded the ray bounce limit, no more light is gathered.
-            if (depth <= 0) return color(0,0,0); // should be black like the bottom side of objects
+            for (int bounce = 0; bounce < depth; bounce++) {
+                hit_record rec;
 
-            // === NEW VERSION ===
-            // If the ray hits nothing, return the background color.
-            if(!world.hit(r, interval(0.001, infinity), rec)) { // solving shadow acne problem by setting min t0 0.001 instead of 0
-                if(sky) {
-                    vec3 unit_direction = unit_vector(r.direction()); // --> vec3 unit_direction = r.direction() / r.direction().length();
-                    auto a = 0.5*(unit_direction.y() + 1.0); // color changes based on the y-coordinate (y is in [-1,1])
-                    return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0); // color scheme, that creates blue-to-white gradient
+                // If the ray hits nothing, the background color is all that is left.
+                if(!world.hit(r, interval(0.001, infinity), rec)) { // solving shadow acne problem by setting min t0 0.001 instead of 0
+                    color light = throughput * background_color(r);
+                    radiance += light;
+                    if (lights) lights->add(nullptr, light);
+                    break;
                 }
-                return background;
+
+                ray scattered;
+                if (!path_vertex(r, rec, bounce, world, throughput, radiance, scatter_pdf, scattered, lights)) break;
+                r = scattered;
             }
-                
-            ray scattered;
+            return radiance;
+        }
+
+        bool path_vertex(const ray& r, const hit_record& rec, int bounce, const hittable& world,
+                         color& throughput, color& radiance, double& scatter_pdf, ray& scattered,
+                         light_sample* lights = nullptr) const {
+            // One bounce of a path: adds the light emitted at the hit point and scatters the ray. Returns false if the
+            // --> path ends here. (shared by ray_color and the wavefront shading stage)
+            // --> With lights, every contribution is also booked on the light it came from.
+            // --> scatter_pdf comes in as the density with which the previous bounce picked r (0 for camera rays and
+            // --> mirror-like bounces) and goes out as the one of scattered.
+            auto& rng = thread_sampler();
+            auto first_dimension = camera_dimensions + static_cast<uint64_t>(bounce) * bounce_dimensions;
             color attenuation;
-            color color_scattered;
-            color color_emitted = rec.mat->emitted(rec.u, rec.v, rec.p); // emitted color is not black, only if rec.mat is a light source
+            color emitted = rec.mat->emitted(rec.u, rec.v, rec.p); // emitted color is not black, only if rec.mat is a light source
+            if (sampled_lights != nullptr && scatter_pdf > 0 && (emitted.x() > 0 || emitted.y() > 0 || emitted.z() > 0)) {
+                // The previous bounce may also have found this light by light sampling, the two estimates share the weight
+                auto light_pdf = sampled_lights->pdf_value(r.origin(), r.direction());
+                emitted *= power_heuristic(scatter_pdf, light_pdf);
+            }
+            radiance += throughput * emitted;
+            if (lights) lights->add(rec.mat, throughput * emitted);
 
+            rng.start_dimension(first_dimension);
             if (!rec.mat->scatter(r, rec, attenuation, scattered)) { // this if is important, if scatter is false (this might be false
-                // --> for metal objects due to fuzzyness), we want the object to absorb all light, making it color(0,0,0)
-                return color_emitted;
+                // --> for metal objects due to fuzzyness), we want the object to absorb all light
+                return false;
             }
+            scatter_pdf = rec.mat->scattering_pdf(r, rec, scattered);
 
-            color_scattered = attenuation * ray_color(scattered, depth-1, world);
-            return color_emitted + color_scattered;
-            
-            // === OLD VERSION === --> see how this logic is implemented in the new version
-            // if(world.hit(r, interval(0.001, infinity), rec)) { // solving shadow acne problem by setting min t0 0.001 instead of 0
-            //     ray scattered;
-            //     color attenuation;
-            //     if (rec.mat->scatter(r, rec, attenuation, scattered)) { // this if is important, if scatter is false (this might be false
-            //         // --> for metal objects due to fuzzyness), we want the object to absorb all light, making it color(0,0,0)
-            //         return attenuation * ray_color(scattered, depth-1, world); // attenuation is a color!
-            //     }
-            //     return color(0,0,0);
-            // }
-            // vec3 unit_direction = unit_vector(r.direction()); // --> vec3 unit_direction = r.direction() / r.direction().length();
-            // auto a = 0.5*(unit_direction.y() + 1.0); // color changes based on the y-coordinate (y is in [-1,1])
-            // return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0); // color scheme, that creates blue-to-white gradient
-            // // The background color acts as a light source! --> we are basically backtracing the light reaching our camera
+            // Next-event estimation: diffuse surfaces & media also look for light directly, with a shadow ray towards a
+            // --> point on one of the lights. (not at the last bounce, there the scattered ray would not find light either)
+            if (sampled_lights != nullptr && scatter_pdf > 0 && bounce + 1 < max_depth) {
+                rng.start_dimension(first_dimension + 3);
+                const material* light = nullptr;
+                color direct = throughput * attenuation * sample_light(r, rec, world, light);
+                radiance += direct;
+                if (lights) lights->add(light, direct);
+            }
+
+            throughput = throughput * attenuation;
+
+            // Russian roulette: past roulette_depth, a path survives with probability p (its largest throughput
+            // --> component), and the survivors are weighted with 1/p. This keeps the estimate unbiased, but paths
+            // --> that would hardly contribute anymore stop costing time.
+            if (roulette_depth >= 0 && bounce + 1 >= roulette_depth) {
+                auto p = fmin(fmax(throughput.x(), fmax(throughput.y(), throughput.z())), 1.0);
+                rng.start_dimension(first_dimension + 2);
+                if (random_double() >= p) return false;
+                throughput /= p;
+            }
+            rng.start_dimension(first_dimension + bounce_dimensions/2); // for the intersection of scattered (media draw there)
+            RT_RAY(secondary_rays);
+            return true;
+        }
+
+        color sample_light(const ray& r, const hit_record& rec, const hittable& world, const material*& light) const {
+            // Light arriving at rec.p along a direction picked by sampled_lights, weighted against the chance that
+            // --> scatter() picks the same direction (multiple importance sampling, power heuristic).
+            // --> The result still has to be multiplied with the attenuation of rec.mat. light: the material it came from.
+            ray shadow(rec.p, sampled_lights->random(rec.p), r.time());
+            auto light_pdf = sampled_lights->pdf_value(shadow.origin(), shadow.direction());
+            auto bsdf_pdf = rec.mat->scattering_pdf(r, rec, shadow);
+            if (light_pdf <= 0 || bsdf_pdf <= 0)
+                return color(0,0,0);
+
+            // Whatever the shadow ray hits first is the light it sees: an occluder (black), or an emitter
+            RT_RAY(shadow_rays);
+            hit_record light_rec;
+            if (!world.hit(shadow, interval(0.001, infinity), light_rec))
+                return color(0,0,0);
+            color emitted = light_rec.mat->emitted(light_rec.u, light_rec.v, light_rec.p);
+            light = light_rec.mat;
+            return emitted * (bsdf_pdf / light_pdf * power_heuristic(light_pdf, bsdf_pdf));
+        }
+
+        void report_stats(std::chrono::steady_clock::time_point render_start) const {
+            // Counters of the render that just finished: a table on clog, and JSON for scripts (stats_path or clog)
+#ifdef RT_STATS
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - render_start).count();
+            auto totals = render_stats::total();
+            render_stats::print_table(clog, totals, seconds);
+            if (stats_path.empty()) {
+                render_stats::write_json(clog, totals, seconds);
+            } else {
+                ofstream file(stats_path);
+                render_stats::write_json(file, totals, seconds);
+                if (!file) clog << "Could not write statistics to '" << stats_path << "'\n";
+            }
+#else
+            (void)render_start;
+#endif
+        }
+
+        static double power_heuristic(double pdf, double other_pdf) {
+            return pdf*pdf / (pdf*pdf + other_pdf*other_pdf);
+        }
+
+        color background_color(const ray& r) const {
+            if(sky) {
+                vec3 unit_direction = unit_vector(r.direction()); // --> vec3 unit_direction = r.direction() / r.direction().length();
+                auto a = 0.5*(unit_direction.y() + 1.0); // color changes based on the y-coordinate (y is in [-1,1])
+                return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0); // color scheme, that creates blue-to-white gradient
+            }
+            // The background color acts as a light source! --> we are basically backtracing the light reaching our camera
+            return background;
+        }
+
+        void display_tile(const tile& t, const hittable& world) {
+            if (ray_packets && !world.random_hit()) { // volumes draw random numbers while intersecting, see hittable::random_hit
+                display_packets(t, world);
+                return;
+            }
+            for (int j = t.y0; j < t.y1; ++j) {
+                for (int i = t.x0; i < t.x1; ++i) {
+                    ray r = get_ray(i, j, 0);
+                    film.add_sample(film.index(i, j), ray_color_display(r, world));
+                }
+            }
+        }
+
+        static image scaled(const image& img, int width, int height) {
+            // Nearest neighbour scaling, for the low resolution preview passes
+            if (img.width == width && img.height == height) return img;
+            image out(width, height);
+            for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                    const float* from = img.pixel(std::min(i * img.width / width, img.width - 1), std::min(j * img.height / height, img.height - 1));
+                    std::copy(from, from + 3, out.pixel(i, j));
+                }
+            }
+            return out;
+        }
+
+        void display_packets(const tile& t, const hittable& world) {
+            // Primary rays of neighbouring pixels run through the same BVH nodes and hit the same objects, so they
+            // --> are intersected as a packet of 4x4 rays. Shading is done per ray afterwards, each ray continuing the
+            // --> random stream of its own pixel, thus the image is the same as without packets.
+            const int side = 4;
+            for (int j0 = t.y0; j0 < t.y1; j0 += side) {
+                for (int i0 = t.x0; i0 < t.x1; i0 += side) {
+                    ray_packet packet;
+                    sampler samplers[ray_packet::max_size];
+                    size_t pixels[ray_packet::max_size];
+                    for (int j = j0; j < std::min(j0 + side, t.y1); ++j) {
+                        for (int i = i0; i < std::min(i0 + side, t.x1); ++i) {
+                            ray r = get_ray(i, j, 0);
+                            samplers[packet.size] = thread_sampler();
+                            pixels[packet.size] = film.index(i, j);
+                            packet.add(r, interval(0.001, infinity));
+                        }
+                    }
+
+                    hit_record recs[ray_packet::max_size];
+                    world.hit_packet(packet, packet.full_mask(), recs);
+
+                    for (int k = 0; k < packet.size; k++) {
+                        thread_sampler() = samplers[k];
+                        film.add_sample(pixels[k], shade_display(packet.rays[k], packet.hit[k], recs[k]));
+                    }
+                }
+            }
         }
 
         color ray_color_display(const ray& r, const hittable& world) const {
             hit_record rec;
+            bool hit = world.hit(r, interval(0.001, infinity), rec);
+            return shade_display(r, hit, rec);
+        }
 
-            if(!world.hit(r, interval(0.001, infinity), rec)) {
+        color shade_display(const ray& r, bool hit, const hit_record& rec) const {
+            if(!hit) {
                 // Display sky background
                 vec3 unit_direction = unit_vector(r.direction());
                 auto a = 0.5*(unit_direction.y() + 1.0);
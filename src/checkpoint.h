@@ -0,0 +1,175 @@
+// Saving & restoring the accumulated samples of a render
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h> // fsync
+
+using namespace std;
+
+struct sample_settings {
+    // Everything the samples of a pixel depend on, besides the pixel and the scene: the seed of the streams, the
+    // --> sample count & pattern (stratified and Sobol points are laid out for samples_per_pixel), and which pixels
+    // --> adaptive sampling stops early. A checkpoint or a part only fits a render with the same ones.
+    uint64_t seed = 0;
+    int32_t samples_per_pixel = 0;
+    int32_t pattern = 0;  // sample_pattern
+    int32_t adaptive = 0; // 0, or 1 with the next two set
+    int32_t min_samples = 0;
+    double adaptive_tolerance = 0;
+
+    bool operator==(const sample_settings& o) const {
+        return seed == o.seed && samples_per_pixel == o.samples_per_pixel && pattern == o.pattern
+            && adaptive == o.adaptive && min_samples == o.min_samples && adaptive_tolerance == o.adaptive_tolerance;
+    }
+    bool operator!=(const sample_settings& o) const { return !(*this == o); }
+};
+
+inline ostream& operator<<(ostream& out, const sample_settings& s) {
+    static const char* patterns[] = {"independent", "stratified", "sobol"};
+    out << "seed " << s.seed << ", " << s.samples_per_pixel << " spp, "
+        << ((s.pattern >= 0 && s.pattern < 3) ? patterns[s.pattern] : "unknown") << " sampling";
+    if (s.adaptive) out << ", adaptive (min " << s.min_samples << ", tolerance " << s.adaptive_tolerance << ")";
+    return out;
+}
+
+class checkpoint {
+    // Binary file: header (magic, version, width, height, sample_settings) followed by the raw framebuffer arrays.
+    // --> Together with the settings, the per-pixel sample counts are the complete RNG state: sample k of a pixel
+    // --> always draws from the stream keyed by (seed, pixel, k), see sampler.h.
+    // --> Files are written to <path>.tmp first and then renamed, so a crash while saving never leaves a
+    // --> half-written checkpoint behind.
+
+    public:
+        static bool save(const string& path, const framebuffer& fb, const sample_settings& settings) {
+            auto tmp_path = path + ".tmp";
+            FILE* file = fopen(tmp_path.c_str(), "wb");
+            if (file == NULL) {
+                clog << "ERROR: Could not open checkpoint file '" << tmp_path << "'.\n";
+                return false;
+            }
+
+            header h;
+            memcpy(h.magic, magic, sizeof(h.magic));
+            h.version = version;
+            h.width = fb.width;
+            h.height = fb.height;
+            h.settings = settings;
+
+            size_t n = fb.sample_count.size();
+            bool ok = fwrite(&h, sizeof(h), 1, file) == 1
+                && fwrite(fb.color_sum.data(), sizeof(color), n, file) == n
+                && fwrite(fb.luminance_sq_sum.data(), sizeof(double), n, file) == n
+                && fwrite(fb.sample_count.data(), sizeof(int), n, file) == n
+                && fwrite(fb.converged.data(), sizeof(unsigned char), n, file) == n
+                && fwrite(fb.first_variance.data(), sizeof(float), n, file) == n
+                && fflush(file) == 0
+                && fsync(fileno(file)) == 0;
+            ok = (fclose(file) == 0) && ok;
+
+            if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+                clog << "ERROR: Could not write checkpoint file '" << path << "'.\n";
+                remove(tmp_path.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        static bool load(const string& path, framebuffer& fb, const sample_settings& settings) {
+            // Fills fb from the checkpoint. Fails (leaving fb untouched) if the file does not exist, or was
+            // --> written for a different image size or different sample settings.
+            framebuffer loaded;
+            sample_settings file_settings;
+            bool exists;
+            if (!read(path, loaded, file_settings, exists)) {
+                if (exists) clog << "ERROR: Could not read checkpoint file '" << path << "'.\n";
+                return false;
+            }
+            if (!matches(path, loaded, file_settings, fb.width, fb.height, settings)) return false;
+            fb = std::move(loaded);
+            return true;
+        }
+
+        static bool exists(const string& path) {
+            return access(path.c_str(), F_OK) == 0;
+        }
+
+        static bool add(const string& path, framebuffer& sum, sample_settings& settings) {
+            // Adds the samples of a partial render (see camera::partial_path) to sum. An empty sum takes the size
+            // --> & settings of the file, any further file has to match them.
+            framebuffer part;
+            sample_settings file_settings;
+            bool exists;
+            if (!read(path, part, file_settings, exists)) {
+                clog << "ERROR: Could not read partial render '" << path << "'.\n";
+                return false;
+            }
+            if (sum.width == 0) {
+                sum.reset(part.width, part.height);
+                settings = file_settings;
+            }
+            if (!matches(path, part, file_settings, sum.width, sum.height, settings)) return false;
+
+            for (size_t idx = 0; idx < sum.sample_count.size(); idx++) {
+                sum.color_sum[idx] += part.color_sum[idx];
+                sum.luminance_sq_sum[idx] += part.luminance_sq_sum[idx];
+                sum.sample_count[idx] += part.sample_count[idx];
+                sum.converged[idx] |= part.converged[idx];
+                sum.first_variance[idx] = std::max(sum.first_variance[idx], part.first_variance[idx]);
+            }
+            return true;
+        }
+
+    private:
+        struct header {
+            char magic[8];
+            uint32_t version;
+            int32_t width;
+            int32_t height;
+            sample_settings settings;
+        };
+
+        static bool read(const string& path, framebuffer& fb, sample_settings& settings, bool& exists) {
+            FILE* file = fopen(path.c_str(), "rb");
+            exists = (file != NULL);
+            if (!exists) return false;
+
+            header h;
+            bool ok = fread(&h, sizeof(h), 1, file) == 1
+                && memcmp(h.magic, magic, sizeof(h.magic)) == 0
+                && h.version == version
+                && h.width > 0 && h.height > 0;
+            if (ok) {
+                fb.reset(h.width, h.height);
+                settings = h.settings;
+                size_t n = fb.sample_count.size();
+                ok = fread(fb.color_sum.data(), sizeof(color), n, file) == n
+                    && fread(fb.luminance_sq_sum.data(), sizeof(double), n, file) == n
+                    && fread(fb.sample_count.data(), sizeof(int), n, file) == n
+                    && fread(fb.converged.data(), sizeof(unsigned char), n, file) == n
+                    && fread(fb.first_variance.data(), sizeof(float), n, file) == n;
+            }
+            fclose(file);
+            return ok;
+        }
+
+        static bool matches(const string& path, const framebuffer& fb, const sample_settings& file_settings, int width,
+                            int height, const sample_settings& settings) {
+            if (fb.width == width && fb.height == height && file_settings == settings) return true;
+            clog << "ERROR: '" << path << "' belongs to a different render (" << fb.width << "x" << fb.height << ", "
+                << file_settings << "), not to this one (" << width << "x" << height << ", " << settings << ").\n";
+            return false;
+        }
+
+        static constexpr char magic[8] = {'R', 'T', 'C', 'K', 'P', 'T', 0, 0};
+        static const uint32_t version = 3;
+};
+
+#endif
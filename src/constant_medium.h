@@ -20,6 +20,7 @@ class constant_medium : public hittable {
             // Print occasional samples when debugging. To enable, set enableDebug true.
             const bool enableDebug = false;
             const bool debugging = enableDebug && random_double() < 0.00001;
+            RT_STAT(medium_tests);
 
             hit_record rec1, rec2;
 
@@ -58,13 +59,16 @@ class constant_medium : public hittable {
 
             rec.normal = vec3(1,0,0);  // arbitrary
             rec.front_face = true;     // also arbitrary
-            rec.mat = phase_function;
+            rec.mat = phase_function.get();
 
+            RT_STAT(medium_hits);
             return true;
         }
 
         aabb bounding_box() const override { return boundary->bounding_box(); }
 
+        bool random_hit() const override { return true; } // the distance into the medium is random
+
     private:
         shared_ptr<hittable> boundary; // define boundary as a surface
         double neg_inv_density;
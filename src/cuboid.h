@@ -95,7 +95,7 @@ class cuboid : public hittable { // extends hittable
                     break;
                 }
                 rec.set_face_normal(r, outward_normal);
-                rec.mat = mat;
+                rec.mat = mat.get();
                 return true;
             } else {
                 return false;
@@ -103,8 +103,11 @@ class cuboid : public hittable { // extends hittable
         }
 
         bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            RT_STAT(cuboid_tests);
             if ((alpha==0.0) && (beta==0.0) && (gamma==0.0)) { 
-                return hit_aligned(r, ray_t, rec); 
+                if (!hit_aligned(r, ray_t, rec)) return false;
+                RT_STAT(cuboid_hits);
+                return true;
             }
             vec3 translation = point3(0,0,0) - center; // calculating the translation vector 
             point3 ray_origin_rotated = rotate3d(r.origin()+translation, alpha, beta, gamma, true, angles);
@@ -117,6 +120,7 @@ class cuboid : public hittable { // extends hittable
                 vec3 rotated_normal = rotate3d(rec.p + rec.normal, alpha, beta, gamma, false, angles) - translation - rotated_p;
                 rec.p = rotated_p;
                 rec.normal = rotated_normal;
+                RT_STAT(cuboid_hits);
                 return true;
             } else {
                 return false;
@@ -0,0 +1,149 @@
+// Edge-aware denoising of a rendered image
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "framebuffer.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+class denoiser {
+    // Edge-avoiding a-trous wavelet filter --> Dammertz et al., "Edge-Avoiding A-Trous Wavelet Transform for fast
+    // --> Global Illumination Filtering" (2010), with the variance guided color weight of SVGF (Schied et al. 2017).
+    // --> Every iteration blurs with a 5x5 B3-spline kernel whose taps are 2^i pixels apart, so 5 iterations cover
+    // --> a 61x61 pixel footprint at 25 taps per pixel each. A neighbour only counts if it has a similar normal, a
+    // --> similar albedo and a color that is within the noise level of the pixel; thus edges & textures stay sharp.
+    // --> The filter runs on the illumination (color / albedo), the texture detail is multiplied back in afterwards.
+
+    public:
+        int iterations = 5;
+        double sigma_luminance = 4.0; // Allowed luminance difference, in standard deviations of the pixel's noise
+        double sigma_normal = 128.0;  // Exponent of the normal similarity (dot product)
+        double sigma_albedo = 0.1;    // Allowed albedo difference
+        int num_threads = 0;
+
+        // Functions
+        image run(const image& noisy, const image& albedo, const image& normal, const vector<float>& variance) const {
+            // variance: per pixel variance of the luminance estimate (i.e. of the pixel mean, not of a single sample)
+            int w = noisy.width, h = noisy.height;
+            size_t n = static_cast<size_t>(w) * h;
+
+            // Demodulate
+            image illumination(w, h);
+            vector<float> var(n);
+            for (size_t idx = 0; idx < n; idx++) {
+                for (int c = 0; c < 3; c++)
+                    illumination.rgb[3*idx + c] = noisy.rgb[3*idx + c] / demodulation(albedo.rgb[3*idx + c]);
+                auto a = luminance(&albedo.rgb[3*idx]);
+                var[idx] = variance[idx] / static_cast<float>(fmax(a*a, 1e-4));
+            }
+
+            thread_pool pool(num_threads);
+            image next(w, h);
+            vector<float> next_var(n);
+            vector<float> smooth_var(n);
+            for (int i = 0; i < iterations; i++) {
+                int step = 1 << i;
+                pool.parallel_for(static_cast<size_t>(h), 1, [&](size_t row) {
+                    int y = static_cast<int>(row);
+                    for (int x = 0; x < w; x++)
+                        smooth_var[static_cast<size_t>(y) * w + x] = blur_3x3(var, x, y, w, h);
+                });
+                pool.parallel_for(static_cast<size_t>(h), 1, [&](size_t row) {
+                    int y = static_cast<int>(row);
+                    for (int x = 0; x < w; x++)
+                        filter_pixel(x, y, step, illumination, albedo, normal, var, smooth_var, next, next_var);
+                });
+                std::swap(illumination, next);
+                std::swap(var, next_var);
+            }
+
+            // Remodulate
+            image result(w, h);
+            for (size_t k = 0; k < 3*n; k++)
+                result.rgb[k] = illumination.rgb[k] * demodulation(albedo.rgb[k]);
+            return result;
+        }
+
+    private:
+        static float demodulation(float albedo) { return fmaxf(albedo, 0.01f); } // no division by (almost) zero
+
+        static double luminance(const float* c) {
+            return 0.2126*c[0] + 0.7152*c[1] + 0.0722*c[2];
+        }
+
+        static float blur_3x3(const vector<float>& v, int x, int y, int w, int h) {
+            // The variance estimates of single pixels are noisy themselves, the color weight uses them smoothed
+            static const float kernel[3] = {0.25f, 0.5f, 0.25f};
+            float sum = 0, sum_weight = 0;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int qx = x + dx, qy = y + dy;
+                    if (qx < 0 || qx >= w || qy < 0 || qy >= h) continue;
+                    float k = kernel[dx+1] * kernel[dy+1];
+                    sum += k * v[static_cast<size_t>(qy) * w + qx];
+                    sum_weight += k;
+                }
+            }
+            return sum / sum_weight;
+        }
+
+        double normal_weight(const float* n_p, const float* n_q) const {
+            // Pixels where the camera ray hit nothing have normal (0,0,0), they only mix among themselves
+            bool surface_p = (n_p[0] != 0 || n_p[1] != 0 || n_p[2] != 0);
+            bool surface_q = (n_q[0] != 0 || n_q[1] != 0 || n_q[2] != 0);
+            if (!surface_p || !surface_q) return (surface_p == surface_q) ? 1.0 : 0.0;
+            return pow(fmax(n_p[0]*n_q[0] + n_p[1]*n_q[1] + n_p[2]*n_q[2], 0.0), sigma_normal);
+        }
+
+        void filter_pixel(int x, int y, int step, const image& in, const image& albedo, const image& normal,
+                          const vector<float>& var, const vector<float>& smooth_var, image& out, vector<float>& out_var) const {
+            static const double kernel[5] = {1.0/16, 1.0/4, 3.0/8, 1.0/4, 1.0/16};
+            int w = in.width, h = in.height;
+            size_t p = static_cast<size_t>(y) * w + x;
+
+            const float* c_p = in.pixel(x, y);
+            const float* n_p = normal.pixel(x, y);
+            const float* a_p = albedo.pixel(x, y);
+            double l_p = luminance(c_p);
+
+            double sum[3] = {0, 0, 0};
+            double sum_weight = 0, sum_var = 0;
+            for (int dy = -2; dy <= 2; dy++) {
+                int qy = y + dy*step;
+                if (qy < 0 || qy >= h) continue;
+                for (int dx = -2; dx <= 2; dx++) {
+                    int qx = x + dx*step;
+                    if (qx < 0 || qx >= w) continue;
+                    size_t q = static_cast<size_t>(qy) * w + qx;
+
+                    double weight = kernel[dx+2] * kernel[dy+2];
+                    if (q != p) {
+                        const float* n_q = normal.pixel(qx, qy);
+                        const float* a_q = albedo.pixel(qx, qy);
+                        double a_diff = (a_p[0]-a_q[0])*(a_p[0]-a_q[0]) + (a_p[1]-a_q[1])*(a_p[1]-a_q[1])
+                                      + (a_p[2]-a_q[2])*(a_p[2]-a_q[2]);
+                        // Noise level of the difference of the two pixels, from their (smoothed) variances. Using both
+                        // --> keeps the weight symmetric: a pixel that happens to have a low variance estimate still mixes.
+                        double noise = sigma_luminance * sqrt(fmax(smooth_var[p] + smooth_var[q], 0.0f)) + 1e-6;
+                        weight *= normal_weight(n_p, n_q)
+                                * exp(-a_diff / (sigma_albedo*sigma_albedo))
+                                * exp(-fabs(l_p - luminance(in.pixel(qx, qy))) / noise);
+                    }
+                    const float* c_q = in.pixel(qx, qy);
+                    for (int c = 0; c < 3; c++) sum[c] += weight * c_q[c];
+                    sum_weight += weight;
+                    sum_var += weight * weight * var[q];
+                }
+            }
+
+            float* o = out.pixel(x, y);
+            for (int c = 0; c < 3; c++) o[c] = static_cast<float>(sum[c] / sum_weight);
+            out_var[p] = static_cast<float>(sum_var / (sum_weight * sum_weight));
+        }
+};
+
+#endif
@@ -0,0 +1,225 @@
+// Distributed rendering --> splits one render into parts, runs every part as a worker process of ./main and merges
+// --> the partial results into the final image
+// Usage: ./distribute [--tiles N] [--sample-parts N] [--workers N] [--retries N] [--launch prefix] [--main path]
+//                     [--dir partials] [--keep] -o image.(ppm|pfm|png) -- <arguments of ./main for the render>
+//        ./distribute --merge -o image.(ppm|pfm|png) <partial files ...>
+// --> The render is cut into --tiles tile sets (every N-th tile of the image) times --sample-parts sample ranges.
+// --> Worker p runs './main <arguments> part=t/N sample_part=s/M partial=<dir>/part_<p>.rtp' and saves its samples,
+// --> at most --workers of them at a time. A worker that fails (or leaves no partial file) is run again, up to
+// --> --retries times. --launch is put in front of every worker command, e.g. --launch 'ssh render{slot}' runs the
+// --> workers on other machines ({slot} is the worker slot 0..workers-1): they need the same files at the same paths.
+// --> Every sample uses the random stream of its (seed, pixel, sample), so the merged image is the one a single
+// --> process renders (exactly so for tile sets, up to float rounding of the sums for sample ranges).
+// --> Denoising needs the whole image's feature buffers, render those in a single process.
+
+#include "checkpoint.h"
+#include "image_writer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+struct distribute_options {
+    int tile_parts = 4;
+    int sample_parts = 1;
+    int workers = 2;
+    int retries = 2;
+    string launch = "";     // Prefix of every worker command, {slot} is replaced by the worker slot
+    string main_path = "";  // The ./main next to this executable by default
+    string dir = "partials"; // Partial files & worker logs go there
+    bool keep = false;      // Keep the partial files & worker logs after merging
+    string output_path = "";
+    vector<string> job;     // Arguments of ./main
+};
+
+static string quote(const string& s) {
+    // Single quotes for /bin/sh
+    string q = "'";
+    for (char c : s) {
+        if (c == '\'') q += "'\\''";
+        else q += c;
+    }
+    return q + "'";
+}
+
+static string replace_all(string s, const string& from, const string& to) {
+    for (auto pos = s.find(from); pos != string::npos; pos = s.find(from, pos + to.size())) s.replace(pos, from.size(), to);
+    return s;
+}
+
+bool merge(const vector<string>& partials, const string& output_path) {
+    framebuffer sum;
+    sample_settings settings;
+    for (const auto& path : partials)
+        if (!checkpoint::add(path, sum, settings)) return false;
+    if (partials.empty()) {
+        clog << "ERROR: Nothing to merge.\n";
+        return false;
+    }
+
+    size_t missing = 0;
+    for (auto n : sum.sample_count) if (n == 0) missing++;
+    if (missing > 0) clog << "Warning: " << missing << " pixels have no samples (is a part missing?)\n";
+    return write_image(output_path, sum.resolve());
+}
+
+bool run_parts(const distribute_options& options, vector<string>& partials) {
+    // Runs every part as a worker process, at most options.workers at a time, and retries the failed ones
+    struct part { int tile, sample, attempts = 0; string partial, log; };
+    vector<part> parts;
+    for (int s = 0; s < options.sample_parts; s++) {
+        for (int t = 0; t < options.tile_parts; t++) {
+            part p;
+            p.tile = t;
+            p.sample = s;
+            auto name = options.dir + "/part_" + to_string(parts.size());
+            p.partial = name + ".rtp";
+            p.log = name + ".log";
+            remove(p.partial.c_str()); // a file left over from an earlier run must not count as done
+            parts.push_back(p);
+        }
+    }
+
+    bool has_threads = false;
+    for (const auto& arg : options.job) if (arg.rfind("threads=", 0) == 0) has_threads = true;
+    int threads_per_worker = max(1, static_cast<int>(thread::hardware_concurrency()) / options.workers);
+
+    vector<size_t> queue;
+    for (size_t k = 0; k < parts.size(); k++) queue.push_back(k);
+    map<pid_t, pair<size_t, int>> running; // pid -> part, slot
+    vector<bool> slot_busy(options.workers, false);
+    int failed = 0, done = 0;
+
+    while (!queue.empty() || !running.empty()) {
+        while (!queue.empty() && static_cast<int>(running.size()) < options.workers) {
+            size_t k = queue.front();
+            queue.erase(queue.begin());
+            int slot = 0;
+            while (slot_busy[slot]) slot++;
+
+            part& p = parts[k];
+            p.attempts++;
+            string command = options.launch.empty() ? "" : replace_all(options.launch, "{slot}", to_string(slot)) + " ";
+            command += quote(options.main_path);
+            for (const auto& arg : options.job) command += " " + quote(arg);
+            command += " " + quote("part=" + to_string(p.tile) + "/" + to_string(options.tile_parts));
+            command += " " + quote("sample_part=" + to_string(p.sample) + "/" + to_string(options.sample_parts));
+            command += " " + quote("partial=" + p.partial);
+            if (!has_threads) command += " threads=" + to_string(threads_per_worker);
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                int log_fd = open(p.log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                int null_fd = open("/dev/null", O_WRONLY);
+                if (log_fd >= 0) dup2(log_fd, STDERR_FILENO);
+                dup2(null_fd, STDOUT_FILENO);
+                execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+                _exit(127);
+            }
+            if (pid < 0) {
+                clog << "ERROR: Could not start a worker.\n";
+                return false;
+            }
+            running[pid] = {k, slot};
+            slot_busy[slot] = true;
+            clog << "Part " << k << " (tiles " << p.tile << "/" << options.tile_parts << ", samples " << p.sample << "/"
+                 << options.sample_parts << ") started in slot " << slot << (p.attempts > 1 ? ", attempt " + to_string(p.attempts) : "") << "\n";
+        }
+
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0) break;
+        auto it = running.find(pid);
+        if (it == running.end()) continue;
+        auto [k, slot] = it->second;
+        running.erase(it);
+        slot_busy[slot] = false;
+
+        part& p = parts[k];
+        bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && access(p.partial.c_str(), R_OK) == 0;
+        if (ok) {
+            done++;
+            clog << "Part " << k << " done (" << done << " of " << parts.size() << ")\n";
+        } else if (p.attempts <= options.retries) {
+            clog << "Part " << k << " failed (see " << p.log << "), retrying\n";
+            queue.push_back(k);
+        } else {
+            clog << "ERROR: Part " << k << " failed " << p.attempts << " times (see " << p.log << ").\n";
+            failed++;
+        }
+    }
+
+    for (const auto& p : parts) partials.push_back(p.partial);
+    return failed == 0;
+}
+
+int main(int argc, char** argv) {
+    distribute_options options;
+    bool merge_only = false;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            if (i + 1 >= argc) {
+                cerr << "Missing value for " << arg << '\n';
+                exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--") {
+            options.job.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        if (arg == "--tiles") options.tile_parts = max(1, stoi(value()));
+        else if (arg == "--sample-parts") options.sample_parts = max(1, stoi(value()));
+        else if (arg == "--workers") options.workers = max(1, stoi(value()));
+        else if (arg == "--retries") options.retries = max(0, stoi(value()));
+        else if (arg == "--launch") options.launch = value();
+        else if (arg == "--main") options.main_path = value();
+        else if (arg == "--dir") options.dir = value();
+        else if (arg == "--keep") options.keep = true;
+        else if (arg == "-o") options.output_path = value();
+        else if (arg == "--merge") merge_only = true;
+        else if (merge_only && arg[0] != '-') files.push_back(arg);
+        else {
+            cerr << "Unknown option " << arg << " (see the top of distribute.cc)\n";
+            return 1;
+        }
+    }
+    if (options.output_path.empty()) {
+        cerr << "The merged image needs an output path (-o image.png)\n";
+        return 1;
+    }
+    if (merge_only) return merge(files, options.output_path) ? 0 : 1;
+
+    if (options.main_path.empty()) {
+        string self = argv[0];
+        auto slash = self.find_last_of('/');
+        options.main_path = (slash == string::npos ? string(".") : self.substr(0, slash)) + "/main";
+    }
+    if (system(("mkdir -p " + quote(options.dir)).c_str()) != 0) {
+        cerr << "Could not create '" << options.dir << "'\n";
+        return 1;
+    }
+
+    vector<string> partials;
+    if (!run_parts(options, partials)) return 1;
+    if (!merge(partials, options.output_path)) return 1;
+    if (!options.keep) {
+        for (const auto& path : partials) {
+            remove(path.c_str());
+            remove((path.substr(0, path.size() - 4) + ".log").c_str()); // part_<p>.rtp -> part_<p>.log
+        }
+    }
+    clog << "Merged " << partials.size() << " parts into '" << options.output_path << "'\n";
+    return 0;
+}
@@ -0,0 +1,114 @@
+// In-memory render target
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "color.h"
+
+#include <vector>
+
+using namespace std;
+
+class image {
+    // Linear (not gamma corrected) RGB image in row-major order, 3 floats per pixel.
+    // --> this is what the image writers consume
+
+    public:
+        int width = 0;
+        int height = 0;
+        vector<float> rgb;
+
+        // Constructors
+        image() {}
+        image(int w, int h) : width(w), height(h), rgb(static_cast<size_t>(w) * h * 3, 0.0f) {}
+
+        // Functions
+        float* pixel(int i, int j) { return &rgb[(static_cast<size_t>(j) * width + i) * 3]; }
+        const float* pixel(int i, int j) const { return &rgb[(static_cast<size_t>(j) * width + i) * 3]; }
+};
+
+class framebuffer {
+    // Accumulates the radiance of all samples taken per pixel. Nothing is written out while rendering,
+    // --> resolve() turns the sums into the final (linear) image once the camera is done.
+
+    public:
+        int width = 0;
+        int height = 0;
+        vector<color> color_sum;  // Sum of all sample colors of a pixel
+        vector<int> sample_count; // Number of samples that went into color_sum
+        vector<double> luminance_sq_sum; // Sum of the squared sample luminances, for the variance estimate
+        vector<unsigned char> converged; // Set once adaptive sampling decided that a pixel needs no more samples
+        vector<float> first_variance;    // Luminance variance after the pixel's first adaptive round, -1 until then
+
+        // Constructors
+        framebuffer() {}
+        framebuffer(int w, int h) { reset(w, h); }
+
+        // Functions
+        void reset(int w, int h) {
+            width = w;
+            height = h;
+            color_sum.assign(static_cast<size_t>(w) * h, color(0,0,0));
+            sample_count.assign(static_cast<size_t>(w) * h, 0);
+            luminance_sq_sum.assign(static_cast<size_t>(w) * h, 0.0);
+            converged.assign(static_cast<size_t>(w) * h, 0);
+            first_variance.assign(static_cast<size_t>(w) * h, -1.0f);
+        }
+
+        size_t index(int i, int j) const { return static_cast<size_t>(j) * width + i; }
+
+        void add_sample(size_t idx, const color& c) {
+            color_sum[idx] += c;
+            sample_count[idx] += 1;
+            auto l = luminance(c);
+            luminance_sq_sum[idx] += l*l;
+        }
+
+        double mean_luminance(size_t idx) const {
+            int n = sample_count[idx];
+            return (n > 0) ? luminance(color_sum[idx]) / n : 0.0;
+        }
+
+        double luminance_variance(size_t idx) const {
+            // Unbiased sample variance of the pixel's luminance
+            int n = sample_count[idx];
+            if (n < 2) return 0.0;
+            auto mean = luminance(color_sum[idx]) / n;
+            return fmax((luminance_sq_sum[idx] - n*mean*mean) / (n - 1), 0.0);
+        }
+
+        static double luminance(const color& c) { // Rec. 709 weights
+            return 0.2126*c.x() + 0.7152*c.y() + 0.0722*c.z();
+        }
+
+        vector<float> mean_variance() const {
+            // Variance of every pixel's mean luminance, i.e. how noisy the resolved pixel still is
+            vector<float> v(sample_count.size());
+            for (size_t idx = 0; idx < v.size(); idx++)
+                v[idx] = (sample_count[idx] > 0) ? static_cast<float>(luminance_variance(idx) / sample_count[idx]) : 0.0f;
+            return v;
+        }
+
+        image sample_count_map(int max_samples) const {
+            // Visualizes where the sample budget went: sample_count / max_samples in every channel
+            image img(width, height);
+            for (size_t idx = 0; idx < sample_count.size(); idx++) {
+                auto v = static_cast<float>(sample_count[idx]) / max_samples;
+                img.rgb[3*idx + 0] = img.rgb[3*idx + 1] = img.rgb[3*idx + 2] = v;
+            }
+            return img;
+        }
+
+        image resolve() const {
+            // Divide every pixel sum by its sample count
+            image img(width, height);
+            for (size_t idx = 0; idx < color_sum.size(); idx++) {
+                auto scale = (sample_count[idx] > 0) ? 1.0 / sample_count[idx] : 0.0;
+                img.rgb[3*idx + 0] = static_cast<float>(color_sum[idx].x() * scale);
+                img.rgb[3*idx + 1] = static_cast<float>(color_sum[idx].y() * scale);
+                img.rgb[3*idx + 2] = static_cast<float>(color_sum[idx].z() * scale);
+            }
+            return img;
+        }
+};
+
+#endif
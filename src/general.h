@@ -5,6 +5,9 @@
 #include <memory>
 #include <cstdlib>
 
+#include "sampler.h"
+#include "stats.h"
+
 // Usings
 
 using std::shared_ptr;
@@ -25,7 +28,8 @@ inline double degrees_to_radians(double degrees) {
 
 inline double random_double() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    // --> drawn from the calling thread's sampler (see sampler.h) instead of the global, locked rand()
+    return thread_sampler().get_1d();
 }
 
 inline double random_double(double min, double max) {
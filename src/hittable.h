@@ -9,7 +9,7 @@ class hit_record {
     public:
         point3 p; // all of these attributes are filled out within a hit() function
         vec3 normal;
-        shared_ptr<material> mat;
+        const material* mat = nullptr; // raw pointer: the primitive owns the material, and copying a hit_record stays cheap
         double t;
         double u; // surface coordinates / hit point p is not enough to map it to the texture
         double v;
@@ -34,7 +34,39 @@ class hittable { // our abstract class
         // this function checks if the ray hits the sphere, if true, it fills out the hit_record
         // --> ray_t is not const reference, since it is manipulated in aabb hit function (to simplify the calculations)
 
+        virtual void hit_packet(ray_packet& packet, uint32_t mask, hit_record* recs) const {
+            // Intersects the rays of the packet selected by mask. For every ray that hits something closer than
+            // --> packet.t_max, recs[k] is filled out, packet.t_max[k] is set to the hit distance and packet.hit[k] to true.
+            // --> This default traces the rays one by one, objects that can do better (bvh_node, sphere, quad) override it.
+            for (int k = 0; k < packet.size; k++) {
+                if (!(mask & (1u << k))) continue;
+                hit_record temp_rec;
+                if (hit(packet.rays[k], interval(packet.t_min[k], packet.t_max[k]), temp_rec)) {
+                    recs[k] = temp_rec;
+                    packet.t_max[k] = temp_rec.t;
+                    packet.hit[k] = true;
+                }
+            }
+        }
+
         virtual aabb bounding_box() const = 0;
+
+        virtual bool random_hit() const {
+            // True if hit() draws random numbers (constant_medium). A ray packet can not replay the draws of every ray
+            // --> in the order of a ray traced alone, so camera::display() traces such worlds ray by ray.
+            return false;
+        }
+
+        // Light sampling (next-event estimation), only objects that can serve as lights implement these
+        virtual double pdf_value(const point3& origin, const vec3& direction) const {
+            // Probability density (per solid angle) that random(origin) returns direction
+            return 0.0;
+        }
+
+        virtual vec3 random(const point3& origin) const {
+            // Random direction from origin towards this object
+            return vec3(1, 0, 0);
+        }
 };
 
 class translate : public hittable {
@@ -58,6 +90,8 @@ class translate : public hittable {
 
         aabb bounding_box() const override { return bbox; }
 
+        bool random_hit() const override { return object->random_hit(); }
+
     private:
         shared_ptr<hittable> object;
         vec3 offset;
@@ -137,6 +171,8 @@ class rotate_y : public hittable {
 
         aabb bounding_box() const override { return bbox; }
 
+        bool random_hit() const override { return object->random_hit(); }
+
     private:
         shared_ptr<hittable> object;
         double sin_theta;
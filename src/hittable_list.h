@@ -52,10 +52,36 @@ class hittable_list : public hittable { // extends hittable, however we use its
             return hit_anything;
         }
 
+        void hit_packet(ray_packet& packet, uint32_t mask, hit_record* recs) const override {
+            // packet.t_max plays the role of closest_so_far
+            for (const auto& object : objects) object->hit_packet(packet, mask, recs);
+        }
+
         aabb bounding_box() const override {
             return bbox;
         }
 
+        bool random_hit() const override {
+            for (const auto& object : objects)
+                if (object->random_hit()) return true;
+            return false;
+        }
+
+        double pdf_value(const point3& origin, const vec3& direction) const override {
+            // random() picks one of the objects uniformly, so the density is the average of theirs
+            if (objects.empty()) return 0.0;
+            double sum = 0.0;
+            for (const auto& object : objects)
+                sum += object->pdf_value(origin, direction);
+            return sum / objects.size();
+        }
+
+        vec3 random(const point3& origin) const override {
+            if (objects.empty()) return vec3(1, 0, 0);
+            auto int_size = static_cast<int>(objects.size());
+            return objects[std::min(random_int(0, int_size-1), int_size-1)]->random(origin);
+        }
+
     private:
         aabb bbox;
 
@@ -0,0 +1,529 @@
+// Image output (PPM P6, PFM, PNG)
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+inline vector<unsigned char> to_display_bytes(const image& img) {
+    // Gamma 2 correction, clamping and the conversion to [0,255] for the whole image in one pass
+    // --> (same mapping as write_color, but 4 channels at a time instead of a formatted stream write per value)
+    const float* src = img.rgb.data();
+    size_t n = img.rgb.size();
+    vector<unsigned char> bytes(n);
+
+    size_t k = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 top = _mm_set1_ps(0.999f);
+    const __m128 scale = _mm_set1_ps(256.0f);
+    for (; k + 4 <= n; k += 4) {
+        __m128 v = _mm_max_ps(_mm_loadu_ps(src + k), zero);        // no negative values under the sqrt
+        v = _mm_min_ps(_mm_sqrt_ps(v), top);                       // linear_to_gamma & intensity.clamp
+        __m128i q = _mm_cvttps_epi32(_mm_mul_ps(v, scale));        // static_cast<int>(256 * x)
+        q = _mm_packs_epi32(q, q);
+        q = _mm_packus_epi16(q, q);
+        uint32_t packed = static_cast<uint32_t>(_mm_cvtsi128_si32(q));
+        memcpy(&bytes[k], &packed, 4);
+    }
+#endif
+    for (; k < n; k++) {
+        float v = sqrtf(fmaxf(src[k], 0.0f));
+        bytes[k] = static_cast<unsigned char>(256.0f * fminf(v, 0.999f));
+    }
+    return bytes;
+}
+
+class image_writer { // abstract class, one subclass per file format
+
+    public:
+        virtual ~image_writer() = default;
+
+        virtual bool write(ostream& out, const image& img) const = 0;
+};
+
+class ppm_writer : public image_writer { // binary PPM (P6), 8 bits per channel, gamma corrected
+
+    public:
+        bool write(ostream& out, const image& img) const override {
+            auto bytes = to_display_bytes(img);
+            out << "P6\n" << img.width << " " << img.height << "\n255\n";
+            out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            return out.good();
+        }
+};
+
+class pfm_writer : public image_writer { // Portable Float Map, keeps the linear radiance (no gamma, no clamping)
+
+    public:
+        bool write(ostream& out, const image& img) const override {
+            // A negative scale marks little endian data, scanlines are stored bottom-to-top
+            out << "PF\n" << img.width << " " << img.height << "\n" << (is_little_endian() ? "-1.0" : "1.0") << "\n";
+            for (int j = img.height - 1; j >= 0; j--)
+                out.write(reinterpret_cast<const char*>(img.pixel(0, j)), sizeof(float) * 3 * img.width);
+            return out.good();
+        }
+
+    private:
+        static bool is_little_endian() {
+            uint16_t probe = 1;
+            return *reinterpret_cast<unsigned char*>(&probe) == 1;
+        }
+};
+
+class deflate_encoder {
+    // zlib stream (RFC 1950/1951) for png_writer: LZ77 over a 32 KB window, matches found through hash chains of
+    // --> the last 3 bytes, then one deflate block with Huffman codes built for this data. Within a few percent of
+    // --> zlib's default level for rendered images (no lazy matching, a single block).
+
+    public:
+        static vector<unsigned char> compress(const vector<unsigned char>& data) {
+            deflate_encoder e;
+            e.out = {0x78, 0x01};
+            e.find_matches(data);
+            e.write_block();
+            if (e.bit_count > 0) e.out.push_back(e.bit_buffer & 0xff);
+
+            uint32_t adler = adler32(data);
+            for (int shift = 24; shift >= 0; shift -= 8) e.out.push_back((adler >> shift) & 0xff);
+            return e.out;
+        }
+
+        static uint32_t adler32(const vector<unsigned char>& data) {
+            uint32_t a = 1, b = 0;
+            for (size_t i = 0; i < data.size(); ) {
+                size_t end = std::min(data.size(), i + 5552); // the sums can not overflow within 5552 bytes
+                for (; i < end; i++) {
+                    a += data[i];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+            }
+            return (b << 16) | a;
+        }
+
+    private:
+        static constexpr size_t window_size = 32768;
+        static constexpr uint32_t hash_size = 1 << 15;
+        static constexpr size_t max_match = 258;
+        static constexpr int max_chain = 32; // candidates tried per position, more finds little for rendered images
+
+        struct token { uint16_t value, distance; }; // a literal byte (distance 0) or a match of value bytes
+
+        vector<token> tokens;
+        vector<unsigned char> out;
+        uint32_t bit_buffer = 0;
+        int bit_count = 0;
+
+        void find_matches(const vector<unsigned char>& data) {
+            const size_t n = data.size();
+            vector<int32_t> head(hash_size, -1), prev(window_size, -1);
+            auto hash = [&](size_t i) {
+                return ((data[i] << 10) ^ (data[i+1] << 5) ^ data[i+2]) & (hash_size - 1);
+            };
+            auto insert = [&](size_t i) {
+                if (i + 2 >= n) return;
+                uint32_t h = hash(i);
+                prev[i & (window_size - 1)] = head[h];
+                head[h] = static_cast<int32_t>(i);
+            };
+
+            size_t i = 0;
+            while (i < n) {
+                size_t best_length = 0, best_distance = 0;
+                if (i + 2 < n) {
+                    size_t limit = std::min<size_t>(max_match, n - i);
+                    int32_t candidate = head[hash(i)];
+                    for (int chain = 0; chain < max_chain && candidate >= 0; chain++) {
+                        size_t distance = i - candidate;
+                        if (distance > window_size - 1) break;
+                        size_t length = 0;
+                        while (length < limit && data[candidate + length] == data[i + length]) length++;
+                        if (length > best_length) {
+                            best_length = length;
+                            best_distance = distance;
+                            if (length == limit) break;
+                        }
+                        candidate = prev[candidate & (window_size - 1)];
+                    }
+                }
+                if (best_length >= 3) {
+                    tokens.push_back({static_cast<uint16_t>(best_length), static_cast<uint16_t>(best_distance)});
+                    for (size_t k = 0; k < best_length; k++) insert(i + k);
+                    i += best_length;
+                } else {
+                    tokens.push_back({data[i], 0});
+                    insert(i);
+                    i++;
+                }
+            }
+        }
+
+        // The symbols of RFC 1951 3.2.5: a length is coded as symbol 257 + l plus extra bits, a distance as d
+        static const uint16_t* length_base() {
+            static const uint16_t t[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67,
+                                           83, 99, 115, 131, 163, 195, 227, 258};
+            return t;
+        }
+        static const uint8_t* length_extra() {
+            static const uint8_t t[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+            return t;
+        }
+        static const uint16_t* distance_base() {
+            static const uint16_t t[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                           1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+            return t;
+        }
+        static const uint8_t* distance_extra() {
+            static const uint8_t t[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+                                          12, 12, 13, 13};
+            return t;
+        }
+        static int length_symbol(int length) {
+            int l = 28;
+            while (length_base()[l] > length) l--;
+            return l;
+        }
+        static int distance_symbol(int distance) {
+            int d = 29;
+            while (distance_base()[d] > distance) d--;
+            return d;
+        }
+
+        static vector<uint8_t> code_lengths(vector<uint32_t> freq, int limit) {
+            // Huffman code lengths for the symbol frequencies, at most limit bits. Too deep a tree is built again
+            // --> from halved frequencies, which flattens it. At least two symbols get a code, so that the code is
+            // --> complete even when a single symbol is used.
+            int used = 0;
+            for (auto f : freq) used += (f > 0);
+            for (size_t k = 0; used < 2 && k < freq.size(); k++) {
+                if (freq[k] == 0) {
+                    freq[k] = 1;
+                    used++;
+                }
+            }
+            vector<uint8_t> lengths(freq.size(), 0);
+            while (true) {
+                // nodes 0..n-1 are the symbols, the inner nodes follow; ties go to the lower index, for a stable result
+                typedef pair<uint64_t, int> entry;
+                priority_queue<entry, vector<entry>, greater<entry>> queue;
+                vector<int> parent(2 * freq.size(), -1);
+                for (size_t k = 0; k < freq.size(); k++)
+                    if (freq[k] > 0) queue.push({freq[k], static_cast<int>(k)});
+                int next = static_cast<int>(freq.size());
+                while (queue.size() > 1) {
+                    entry a = queue.top(); queue.pop();
+                    entry b = queue.top(); queue.pop();
+                    parent[a.second] = parent[b.second] = next;
+                    queue.push({a.first + b.first, next++});
+                }
+                int deepest = 0;
+                for (size_t k = 0; k < freq.size(); k++) {
+                    if (freq[k] == 0) continue;
+                    int depth = 0;
+                    for (int node = static_cast<int>(k); parent[node] >= 0; node = parent[node]) depth++;
+                    lengths[k] = static_cast<uint8_t>(depth);
+                    deepest = std::max(deepest, depth);
+                }
+                if (deepest <= limit) return lengths;
+                for (auto& f : freq)
+                    if (f > 0) f = (f + 1) / 2;
+            }
+        }
+
+        static vector<uint16_t> canonical_codes(const vector<uint8_t>& lengths) {
+            // The codes of RFC 1951 3.2.2: shorter codes first, equal lengths in symbol order. They are returned bit
+            // --> reversed, since deflate stores a code starting at its most significant bit (see code())
+            int count[16] = {0}, next[16] = {0};
+            for (auto l : lengths) count[l]++;
+            count[0] = 0;
+            for (int bits = 1, code = 0; bits < 16; bits++) {
+                code = (code + count[bits - 1]) << 1;
+                next[bits] = code;
+            }
+            vector<uint16_t> codes(lengths.size(), 0);
+            for (size_t k = 0; k < lengths.size(); k++) {
+                if (lengths[k] == 0) continue;
+                uint32_t value = next[lengths[k]]++, reversed = 0;
+                for (int b = 0; b < lengths[k]; b++) reversed |= ((value >> b) & 1) << (lengths[k] - 1 - b);
+                codes[k] = static_cast<uint16_t>(reversed);
+            }
+            return codes;
+        }
+
+        void write_block() {
+            vector<uint32_t> litlen_freq(286, 0), distance_freq(30, 0);
+            for (const auto& t : tokens) {
+                if (t.distance == 0) litlen_freq[t.value]++;
+                else {
+                    litlen_freq[257 + length_symbol(t.value)]++;
+                    distance_freq[distance_symbol(t.distance)]++;
+                }
+            }
+            litlen_freq[256] = 1; // end of block
+            auto litlen_lengths = code_lengths(litlen_freq, 15), distance_lengths = code_lengths(distance_freq, 15);
+            auto litlen_codes = canonical_codes(litlen_lengths), distance_codes = canonical_codes(distance_lengths);
+
+            int hlit = 286, hdist = 30;
+            while (hlit > 257 && litlen_lengths[hlit - 1] == 0) hlit--;
+            while (hdist > 1 && distance_lengths[hdist - 1] == 0) hdist--;
+
+            // Both code length tables as one sequence, runs shortened with symbols 16 (repeat the previous length
+            // --> 3-6 times), 17 (3-10 zeros) & 18 (11-138 zeros), RFC 1951 3.2.7
+            vector<uint8_t> all(litlen_lengths.begin(), litlen_lengths.begin() + hlit);
+            all.insert(all.end(), distance_lengths.begin(), distance_lengths.begin() + hdist);
+            vector<pair<uint8_t, uint8_t>> runs; // symbol, extra bits value
+            for (size_t k = 0; k < all.size(); ) {
+                size_t run = 1;
+                while (k + run < all.size() && all[k + run] == all[k]) run++;
+                if (all[k] == 0 && run >= 3) {
+                    run = std::min<size_t>(run, 138);
+                    if (run >= 11) runs.push_back({18, static_cast<uint8_t>(run - 11)});
+                    else runs.push_back({17, static_cast<uint8_t>(run - 3)});
+                    k += run;
+                } else if (all[k] != 0 && run >= 4) {
+                    runs.push_back({all[k], 0});
+                    size_t repeat = std::min<size_t>(run - 1, 6);
+                    runs.push_back({16, static_cast<uint8_t>(repeat - 3)});
+                    k += 1 + repeat;
+                } else {
+                    runs.push_back({all[k], 0});
+                    k++;
+                }
+            }
+            vector<uint32_t> length_freq(19, 0);
+            for (const auto& r : runs) length_freq[r.first]++;
+            auto length_lengths = code_lengths(length_freq, 7);
+            auto length_codes = canonical_codes(length_lengths);
+            static const int order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+            int hclen = 19;
+            while (hclen > 4 && length_lengths[order[hclen - 1]] == 0) hclen--;
+
+            bits(1, 1); // the last block
+            bits(2, 2); // dynamic Huffman codes
+            bits(hlit - 257, 5);
+            bits(hdist - 1, 5);
+            bits(hclen - 4, 4);
+            for (int k = 0; k < hclen; k++) bits(length_lengths[order[k]], 3);
+            static const int run_extra[3] = {2, 3, 7};
+            for (const auto& r : runs) {
+                code(length_codes[r.first], length_lengths[r.first]);
+                if (r.first >= 16) bits(r.second, run_extra[r.first - 16]);
+            }
+
+            for (const auto& t : tokens) {
+                if (t.distance == 0) {
+                    code(litlen_codes[t.value], litlen_lengths[t.value]);
+                    continue;
+                }
+                int l = length_symbol(t.value), d = distance_symbol(t.distance);
+                code(litlen_codes[257 + l], litlen_lengths[257 + l]);
+                bits(t.value - length_base()[l], length_extra()[l]);
+                code(distance_codes[d], distance_lengths[d]);
+                bits(t.distance - distance_base()[d], distance_extra()[d]);
+            }
+            code(litlen_codes[256], litlen_lengths[256]);
+        }
+
+        void bits(uint32_t value, int count) { // deflate packs bits starting at the least significant one
+            bit_buffer |= value << bit_count;
+            bit_count += count;
+            while (bit_count >= 8) {
+                out.push_back(bit_buffer & 0xff);
+                bit_buffer >>= 8;
+                bit_count -= 8;
+            }
+        }
+
+        void code(uint32_t reversed_code, int count) { // a code of canonical_codes
+            bits(reversed_code, count);
+        }
+};
+
+class png_writer : public image_writer { // 8-bit RGB PNG, gamma corrected
+    // stb_image (external/) can only read images, so the encoder lives here (with deflate_encoder). Every row gets
+    // --> the PNG filter with the smallest sum of absolute residuals, the usual heuristic, then the whole image is
+    // --> deflated as one stream.
+
+    public:
+        bool write(ostream& out, const image& img) const override {
+            auto bytes = to_display_bytes(img);
+            size_t row_bytes = 3 * static_cast<size_t>(img.width);
+
+            // Filtered scanlines, each preceded by its filter type
+            vector<unsigned char> raw;
+            raw.reserve((row_bytes + 1) * img.height);
+            vector<unsigned char> zero_row(row_bytes, 0), candidate(row_bytes), best(row_bytes);
+            for (int j = 0; j < img.height; j++) {
+                const unsigned char* row = bytes.data() + j * row_bytes;
+                const unsigned char* up = (j > 0) ? row - row_bytes : zero_row.data();
+                uint64_t best_cost = UINT64_MAX;
+                unsigned char best_type = 0;
+                for (unsigned char type = 0; type < 5; type++) {
+                    uint64_t cost = 0;
+                    for (size_t k = 0; k < row_bytes; k++) {
+                        int a = (k >= 3) ? row[k-3] : 0, b = up[k], c = (k >= 3) ? up[k-3] : 0;
+                        candidate[k] = static_cast<unsigned char>(row[k] - predict(type, a, b, c));
+                        cost += std::abs(static_cast<int>(static_cast<signed char>(candidate[k])));
+                    }
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_type = type;
+                        best.swap(candidate);
+                    }
+                }
+                raw.push_back(best_type);
+                raw.insert(raw.end(), best.begin(), best.end());
+            }
+            auto z = deflate_encoder::compress(raw);
+
+            vector<unsigned char> header;
+            push_u32(header, img.width);
+            push_u32(header, img.height);
+            header.insert(header.end(), {8, 2, 0, 0, 0}); // bit depth 8, color type RGB, default compression/filter, no interlace
+
+            static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+            out.write(reinterpret_cast<const char*>(signature), 8);
+            write_chunk(out, "IHDR", header);
+            write_chunk(out, "IDAT", z);
+            write_chunk(out, "IEND", {});
+            return out.good();
+        }
+
+    private:
+        static int predict(int type, int a, int b, int c) { // a: left, b: up, c: up left
+            switch (type) {
+                case 1: return a;                 // Sub
+                case 2: return b;                 // Up
+                case 3: return (a + b) / 2;       // Average
+                case 4: {                         // Paeth
+                    int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    if (pa <= pb && pa <= pc) return a;
+                    return (pb <= pc) ? b : c;
+                }
+                default: return 0;                // None
+            }
+        }
+
+        static void push_u32(vector<unsigned char>& v, uint32_t x) { // PNG is big endian
+            v.push_back((x >> 24) & 0xff);
+            v.push_back((x >> 16) & 0xff);
+            v.push_back((x >> 8) & 0xff);
+            v.push_back(x & 0xff);
+        }
+
+        static uint32_t crc32(uint32_t crc, const unsigned char* data, size_t len) {
+            static const vector<uint32_t> table = [] {
+                vector<uint32_t> t(256);
+                for (uint32_t n = 0; n < 256; n++) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    t[n] = c;
+                }
+                return t;
+            }();
+            crc = ~crc;
+            for (size_t i = 0; i < len; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        static void write_chunk(ostream& out, const char* type, const vector<unsigned char>& data) {
+            vector<unsigned char> length;
+            push_u32(length, static_cast<uint32_t>(data.size()));
+            out.write(reinterpret_cast<const char*>(length.data()), 4);
+            out.write(type, 4);
+            if (!data.empty()) out.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+            uint32_t crc = crc32(0, reinterpret_cast<const unsigned char*>(type), 4);
+            crc = crc32(crc, data.data(), data.size());
+            vector<unsigned char> crc_bytes;
+            push_u32(crc_bytes, crc);
+            out.write(reinterpret_cast<const char*>(crc_bytes.data()), 4);
+        }
+};
+
+inline shared_ptr<image_writer> writer_for(const string& path) {
+    // Pick the writer from the file extension, binary PPM is the default
+    auto ends_with = [&](const string& ext) {
+        return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+    };
+    if (ends_with(".png")) return make_shared<png_writer>();
+    if (ends_with(".pfm")) return make_shared<pfm_writer>();
+    return make_shared<ppm_writer>();
+}
+
+inline bool write_image(const string& path, const image& img) {
+    // Writes img to path (format from the extension), or as binary PPM to stdout if path is empty or "-".
+    // --> The file is written under a temporary name and renamed when complete, so whoever watches the output
+    // --> (e.g. the intermediate images of a progressive render) never sees a half-written image.
+    if (path.empty() || path == "-") return ppm_writer().write(cout, img);
+
+    auto tmp_path = path + ".tmp";
+    bool ok;
+    {
+        ofstream file(tmp_path, ios::binary);
+        if (!file) {
+            clog << "ERROR: Could not open output file '" << tmp_path << "'.\n";
+            return false;
+        }
+        ok = writer_for(path)->write(file, img);
+    }
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        clog << "ERROR: Could not write output file '" << path << "'.\n";
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+inline bool read_pfm(const string& path, image& img) {
+    // The counterpart of pfm_writer, for tools that work on rendered images (e.g. relight.cc)
+    ifstream file(path, ios::binary);
+    string magic;
+    int width, height;
+    double scale;
+    if (!(file >> magic >> width >> height >> scale) || magic != "PF" || width <= 0 || height <= 0) {
+        clog << "ERROR: '" << path << "' is not an RGB PFM image.\n";
+        return false;
+    }
+    file.get(); // the single whitespace character before the data
+
+    uint16_t probe = 1;
+    bool little_endian = (*reinterpret_cast<unsigned char*>(&probe) == 1);
+    img = image(width, height);
+    for (int j = height - 1; j >= 0; j--) // bottom-to-top
+        file.read(reinterpret_cast<char*>(img.pixel(0, j)), sizeof(float) * 3 * width);
+    if (!file) {
+        clog << "ERROR: '" << path << "' ends too early.\n";
+        return false;
+    }
+    if ((scale < 0) != little_endian) { // written on a machine of the other byte order
+        for (auto& f : img.rgb) {
+            unsigned char* b = reinterpret_cast<unsigned char*>(&f);
+            std::swap(b[0], b[3]);
+            std::swap(b[1], b[2]);
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,149 @@
+// Interactive preview --> camera::display_progressive in a loop, started over whenever the camera settings change
+#ifndef INTERACTIVE_H
+#define INTERACTIVE_H
+
+#include "scene_file.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+class interactive_preview {
+    // The scene (objects, meshes, BVHs) stays loaded the whole time, only the camera changes. Settings arrive as
+    // --> lines of key=value pairs (the ones of scene files, see scene_loader::set_option), from stdin or from a
+    // --> control file that is read again whenever it is saved. A change interrupts the pass in progress, the preview
+    // --> starts over at 1/8 resolution with the new settings. 'quit' (or the end of stdin, once the preview is
+    // --> done) ends the session.
+
+    public:
+        string control_path = "";   // Settings file to watch, empty reads stdin
+        double poll_interval = 0.1; // Seconds between two checks of the control file (or of quit, while stdin is quiet)
+
+        // Functions
+        void run(scene& s) {
+            // Both readers check quit at least every poll_interval, so they are joined before this object goes away
+            thread reader;
+            if (control_path.empty()) reader = thread([this] { read_stdin(); });
+            else reader = thread([this] { watch_file(); });
+
+            while (true) {
+                {
+                    lock_guard<mutex> lock(m);
+                    restart = false;
+                    for (const auto& setting : pending)
+                        scene_loader::set_option(s, setting.first, setting.second); // errors are printed, the rest applies
+                    pending.clear();
+                    if (quit) break;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                if (!s.cam.display_progressive(s.world, restart)) continue;
+                clog << "Preview done in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+                     << " s, waiting for changes\n";
+
+                unique_lock<mutex> lock(m);
+                changed.wait(lock, [this] { return restart || quit || input_done; });
+                if (input_done && !restart) break;
+            }
+
+            {
+                lock_guard<mutex> lock(m);
+                quit = true;
+            }
+            if (reader.joinable()) reader.join();
+        }
+
+    private:
+        mutex m;
+        condition_variable changed;
+        vector<pair<string, string>> pending; // Settings not yet applied, in the order they came in
+        atomic<bool> restart{false};
+        bool quit = false;
+        bool input_done = false; // stdin is at its end
+
+        void push(const string& text) {
+            // One or more lines of settings
+            lock_guard<mutex> lock(m);
+            istringstream lines(text);
+            string line;
+            while (getline(lines, line)) {
+                auto comment = line.find('#');
+                if (comment != string::npos) line.erase(comment);
+                istringstream tokens(line);
+                string token;
+                while (tokens >> token) {
+                    auto eq = token.find('=');
+                    if (token == "quit" || token == "q") quit = true;
+                    else if (eq == string::npos) clog << "ERROR: Expected key=value or quit, got '" << token << "'.\n";
+                    else pending.emplace_back(token.substr(0, eq), token.substr(eq + 1));
+                }
+            }
+            restart = true;
+            changed.notify_all();
+        }
+
+        void read_stdin() {
+            // Waits for input with poll() instead of blocking in getline, so the thread ends with the preview: a
+            // --> batch job after it gets stdin back (minus what was read up to then)
+            string text;
+            char buffer[4096];
+            while (true) {
+                {
+                    lock_guard<mutex> lock(m);
+                    if (quit) return;
+                }
+                pollfd p = {STDIN_FILENO, POLLIN, 0};
+                int ready = poll(&p, 1, static_cast<int>(poll_interval * 1000));
+                if (ready == 0 || (ready < 0 && errno == EINTR)) continue;
+                ssize_t n = (ready > 0) ? read(STDIN_FILENO, buffer, sizeof(buffer)) : -1;
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break; // end of input (or an error)
+                text.append(buffer, n);
+                auto end = text.find_last_of('\n');
+                if (end == string::npos) continue;
+                push(text.substr(0, end + 1)); // complete lines only
+                text.erase(0, end + 1);
+            }
+            if (!text.empty()) push(text);
+            lock_guard<mutex> lock(m);
+            input_done = true;
+            changed.notify_all();
+        }
+
+        void watch_file() {
+            // Polls the modification time, the whole file is applied again after every change
+            struct timespec last = {0, 0};
+            while (true) {
+                {
+                    lock_guard<mutex> lock(m);
+                    if (quit) return;
+                }
+                struct stat st;
+                if (stat(control_path.c_str(), &st) == 0
+                    && (st.st_mtim.tv_sec != last.tv_sec || st.st_mtim.tv_nsec != last.tv_nsec)) {
+                    last = st.st_mtim;
+                    ifstream file(control_path);
+                    stringstream text;
+                    text << file.rdbuf();
+                    push(text.str());
+                }
+                this_thread::sleep_for(std::chrono::duration<double>(poll_interval));
+            }
+        }
+};
+
+#endif
@@ -1,633 +1,226 @@
 // https://raytracing.github.io/books/RayTracingInOneWeekend.html 
 
-#include "general.h"
-#include "color.h"
-// #include "ray.h" // in general included
-// #include "vec3.h"
-#include "hittable.h"
-#include "hittable_list.h"
-#include "sphere.h"
-#include "cuboid.h"
-#include "camera.h"
-#include "material.h"
-#include "bvh.h"
-#include "texture.h"
-#include "quad.h"
-#include "mesh.h"
-#include "constant_medium.h"
-#include "mesh_loader.h"
+#include "scene_file.h"
+#include "interactive.h"
 
+#include <cctype>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 
-// At its core, a ray tracer sends rays through pixels and computes the color seen in the direction of those rays.
-void main_schene() {
-
-    // WORLD
-    hittable_list world;
-
-    auto material_ground = make_shared<lambertian>(color(0.2, 0.2, 0.2));
-    auto material_center = make_shared<lambertian>(color(0.0, 0.0, 0.6));
-    auto material_left   = make_shared<dielectric>(1.5);
-    auto material_right  = make_shared<metal>(color(0.8, 0.6, 0.2), 0.0);
-
-    // Our world
-    auto checker = make_shared<checker_texture>(0.32, color(.2, .3, .1), color(.9, .9, .9));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, make_shared<lambertian>(checker)));
-    //world.add(make_shared<sphere>(point3( 0.0, -100.5, -1.0), 100.0, material_ground));
-
-    // world.add(make_shared<sphere>(point3( 0.0,    3.0, -1.0),   0.5, material_center));
-    world.add(make_shared<cuboid>(point3(0.0, 3.5, -1.0), 0.8, 0.8, 0.8, material_center, 
-        pi/4, 2*pi/3, pi/6, "euler"));
-    // ===============================================================================
-    auto material_metal_cuboid  = make_shared<metal>(color(0.95, 0.95, 0.95), 0.05);
-    // world.add(make_shared<cuboid>(point3(-1.0, 0.0, -1.0), 0.8, 0.8, 0.8, material_metal_cuboid));
-    world.add(make_shared<cuboid>(point3(-3.0, 3.0, -1.0), 2.5, 2.5, 2.5, material_metal_cuboid, 
-        0, pi/3, pi/6, "euler"));
-    // ===============================================================================
-    // world.add(make_shared<sphere>(point3(-1.0,    0.0, -1.0),   0.5, material_left));
-    // world.add(make_shared<sphere>(point3(-1.0,    0.0, -1.0),  -0.4, material_left)); // use inverted radius to invert their normals
-    // --> thus making a hollow glass sphere, if you combine the above 2 surfaces
-    // ===============================================================================
-    world.add(make_shared<sphere>(point3( 1.0,    2.5, -1.0),   0.5, material_right));
-
-    // make_shared<T> constructs an object of type T and wraps it in a shared_ptr using args as the parameter list for the constructor of T
-    // world = hittable_list(make_shared<bvh_node>(world));
-
-    // CAMERA
-    camera cam;
-
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.image_width  = 400; // 1200
-    cam.samples_per_pixel = 100;
-    // TODO: make it possible to turn off annealing, since it is computationally very expensive 
-    // --> computes samples_per_pixel ray colors for each pixel! Is there a way to reuse the already calculated values?
-    cam.max_depth = 50;
-    cam.background        = color(0.70, 0.80, 1.00);
-
-    cam.vfov     = 50;
-    cam.lookfrom = point3(0,3.5,4);
-    cam.lookat   = point3(-1,3,-1);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 2.0; 
-    cam.focus_dist    = 3.4;
-
-    cam.render(world);
+// Usage: ./main [scene files (.scene)] [--scene <built-in name>] [key=value ...] [-o output.(ppm|pfm|png)]
+//               [--frames first-last] [--interactive [--control settings file]]
+//        ./main --batch <jobs file>
+//        ./main --help
+//        [--bvh sah|lbvh|median] [--bvh-width 2|4|8] in front of either pick the BVH builder & the children per node
+//        for the whole process (bvh.h & wide_bvh.h, sah & 2 by default)
+// --> Without a scene file or --scene, the built-in final_scene is rendered. key=value are the camera settings of
+// --> scene files (see scene_loader::set_option), they override the ones of the scene. Without -o (or output=) the
+// --> image is written to stdout. A single argument that is neither of these (and does not start with -) is taken
+// --> as the output path.
+// --> Scenes with keyframes render as a sequence of frames (all of them, or the range of --frames) into one image per
+// --> frame: the output path is a pattern like frames/f_%04d.png (one %d or %0Nd, no other %), a path without %
+// --> gets _%04d before its extension. Keyframed camera settings win over the command line ones.
+// --> --interactive shows a quick preview (camera::display at 1/8 resolution first, refined up to the full one) and
+// --> starts it over whenever new key=value settings come in on stdin, or the --control file changes (see
+// --> interactive.h). Point an image viewer that reloads changed files at the output path.
+// --> A jobs file has one such argument list per line ('#' starts a comment), all jobs run in this process and
+// --> share the files, meshes, textures and BVHs the loader has cached.
+
+static bool ends_with(const string& s, const string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
 }
 
-void random_spheres() {
-    hittable_list world;
-
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+static void print_usage() {
+    clog << "Usage: ./main [scene files (.scene)] [--scene <built-in name>] [key=value ...] [-o output.(ppm|pfm|png)]\n"
+            "              [--frames first-last] [--interactive [--control settings file]]\n"
+            "       ./main --batch <jobs file>\n"
+            "       [--bvh sah|lbvh|median] [--bvh-width 2|4|8] in front of either\n"
+            "Without a scene, the built-in final_scene is rendered. key=value are camera settings (width=400 spp=100 ...),\n"
+            "without -o the image goes to stdout. See the top of src/main.cc and the README for the details.\n";
+}
 
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+static bool frame_path(const string& pattern, int frame, string& path) {
+    // The pattern holds one %d or %0Nd (the frame number, padded to N digits), other % are refused. The path is not
+    // --> given to printf, it is a file name of the user's, not a format string.
+    string p = pattern;
+    if (p.find('%') == string::npos) {
+        auto dot = p.find_last_of('.');
+        auto slash = p.find_last_of('/');
+        if (dot == string::npos || (slash != string::npos && dot < slash)) dot = p.size();
+        p.insert(dot, "_%04d");
+    }
+    size_t start = p.find('%'), end = start + 1;
+    bool zeros = end < p.size() && p[end] == '0';
+    if (zeros) end++;
+    size_t width = 0;
+    while (end < p.size() && isdigit(static_cast<unsigned char>(p[end])) && width < 100) width = 10*width + (p[end++] - '0');
+    if (end >= p.size() || p[end] != 'd' || p.find('%', end) != string::npos) {
+        clog << "ERROR: The frame pattern '" << pattern << "' needs exactly one %d or %0Nd and no other %.\n";
+        return false;
+    }
+    string number = to_string(frame);
+    if (number.size() < width) number.insert(0, width - number.size(), zeros ? '0' : ' ');
+    path = p.substr(0, start) + number + p.substr(end + 1);
+    return true;
+}
 
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
+bool render_sequence(const scene& s, int first, int last) {
+    // Every frame is a copy of s with the keyframed settings applied: the copies share all static objects, BVHs,
+    // --> meshes & textures, only the animated objects get new transforms
+    if (s.cam.output_path.empty() || s.cam.output_path == "-") {
+        clog << "ERROR: A sequence needs an output path (-o frames/f_%04d.png).\n";
+        return false;
+    }
+    if (last < 0 || last >= s.anim->frame_count) last = s.anim->frame_count - 1;
+    if (first > last) {
+        clog << "ERROR: The sequence has frames 0 to " << s.anim->frame_count - 1 << " only.\n";
+        return false;
+    }
+    for (int frame = first; frame <= last; frame++) {
+        auto start = std::chrono::steady_clock::now();
+        scene f = s;
+        if (!scene_loader::set_frame(f, frame)) return false;
+        if (!frame_path(s.cam.output_path, frame, f.cam.output_path)) return false;
+        if (!f.cam.checkpoint_path.empty() && !frame_path(s.cam.checkpoint_path, frame, f.cam.checkpoint_path)) return false;
+        if (!f.render()) return false;
+        clog << "Frame " << frame << " of " << s.anim->frame_count - 1 << " done ("
+             << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s)\n";
+    }
+    return true;
+}
 
-                if (choose_mat < 0.8) {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    // world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                    auto center2 = center + vec3(0, random_double(0,.5), 0); // falling spheres
-                    world.add(make_shared<sphere>(center, center2, 0.2, sphere_material));
-                } else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                } else {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+bool run_job(const vector<string>& args, scene_loader& loader) {
+    scene s;
+    bool have_scene = false;
+    string output_path = "";
+    vector<pair<string, string>> overrides;
+    int first_frame = 0, last_frame = -1; // -1: the last frame of the sequence
+    bool interactive = false;
+    string control_path = "";
+
+    for (size_t i = 0; i < args.size(); i++) {
+        const string& arg = args[i];
+        if (arg == "--help" || arg == "-h") {
+            print_usage();
+            return true;
+        } else if (arg == "--interactive") {
+            interactive = true;
+        } else if (arg == "-o" || arg == "--scene" || arg == "--frames" || arg == "--control") {
+            if (i + 1 >= args.size()) {
+                clog << "ERROR: " << arg << " needs a value.\n";
+                return false;
+            }
+            if (arg == "-o") {
+                output_path = args[++i];
+                continue;
+            }
+            if (arg == "--control") {
+                control_path = args[++i];
+                continue;
+            }
+            if (arg == "--frames") {
+                const string& range = args[++i];
+                char rest;
+                int n = sscanf(range.c_str(), "%d-%d%c", &first_frame, &last_frame, &rest);
+                if (n == 1) last_frame = first_frame;
+                if ((n != 1 && n != 2) || first_frame < 0 || last_frame < first_frame) {
+                    clog << "ERROR: Invalid frame range '" << range << "' (use first-last, or a single frame).\n";
+                    return false;
                 }
+                continue;
             }
+            if (have_scene) {
+                clog << "ERROR: A built-in scene can not be combined with other scenes.\n";
+                return false;
+            }
+            if (!loader.load_builtin(args[++i], s)) return false;
+            have_scene = true;
+        } else if (ends_with(arg, ".scene")) {
+            if (!loader.load(arg, s)) return false;
+            have_scene = true;
+        } else if (arg.find('=') != string::npos) {
+            overrides.emplace_back(arg.substr(0, arg.find('=')), arg.substr(arg.find('=') + 1));
+        } else if (args.size() == 1 && arg[0] != '-') {
+            output_path = arg;
+        } else {
+            clog << "ERROR: " << (arg[0] == '-' ? "Unknown option '" : "Unexpected argument '") << arg << "' (see ./main --help).\n";
+            return false;
         }
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
-
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
-
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
-
-    // it is slower with bvh for some reason?
-    // world = hittable_list(make_shared<bvh_node>(world));
-
-    camera cam;
-
-    cam.aspect_ratio      = 16.0 / 9.0;
-    //cam.image_width       = 1200;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    cam.background        = color(0.70, 0.80, 1.00);
-
-    cam.vfov     = 20;
-    cam.lookfrom = point3(13,2,3);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0.6;
-    cam.focus_dist    = 10.0;
-
-    // cam.render(world);
-    cam.display(world);
-}
-
-void two_spheres() {
-    hittable_list world;
-
-    auto checker = make_shared<checker_texture>(0.8, color(.2, .3, .1), color(.9, .9, .9));
-
-    world.add(make_shared<sphere>(point3(0,-10, 0), 10, make_shared<lambertian>(checker)));
-    world.add(make_shared<sphere>(point3(0, 10, 0), 10, make_shared<lambertian>(checker)));
-
-    camera cam;
-
-    cam.aspect_ratio      = 16.0 / 9.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    cam.background        = color(0.70, 0.80, 1.00);
-
-    cam.vfov     = 20;
-    cam.lookfrom = point3(13,2,3);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    cam.render(world);
-}
-
-void earth() {
-    auto earth_texture = make_shared<image_texture>("earthmap.jpg");
-    auto earth_surface = make_shared<lambertian>(earth_texture);
-    auto globe = make_shared<sphere>(point3(0,0,0), 2, earth_surface);
-
-    camera cam;
-
-    cam.aspect_ratio      = 16.0 / 9.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    cam.background        = color(0.70, 0.80, 1.00);
-
-    cam.vfov     = 20;
-    cam.lookfrom = point3(0,0,12);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    cam.render(hittable_list(globe));
-}
-
-void two_perlin_spheres() {
-    hittable_list world;
-
-    auto pertext = make_shared<noise_texture>();
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, make_shared<lambertian>(pertext)));
-    world.add(make_shared<sphere>(point3(0,2,0), 2, make_shared<lambertian>(pertext)));
-
-    camera cam;
-
-    cam.aspect_ratio      = 16.0 / 9.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    cam.background        = color(0.70, 0.80, 1.00);
-
-    cam.vfov     = 20;
-    cam.lookfrom = point3(13,2,3);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    cam.render(world);
-}
-
-void quads() {
-    hittable_list world;
-
-    // Materials
-    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
-    auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
-    auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
-    auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
-    auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
-
-    // Quads
-    world.add(make_shared<quad>(point3(-3,-2, 5), vec3(0, 0,-4), vec3(0, 4, 0), left_red));
-    world.add(make_shared<quad>(point3(-2,-2, 0), vec3(4, 0, 0), vec3(0, 4, 0), back_green));
-    world.add(make_shared<quad>(point3( 3,-2, 1), vec3(0, 0, 4), vec3(0, 4, 0), right_blue));
-    world.add(make_shared<quad>(point3(-2, 3, 1), vec3(4, 0, 0), vec3(0, 0, 4), upper_orange));
-    world.add(make_shared<quad>(point3(-2,-3, 5), vec3(4, 0, 0), vec3(0, 0,-4), lower_teal));
-
-    camera cam;
-
-    cam.aspect_ratio      = 1.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    cam.background        = color(0.70, 0.80, 1.00);
-
-    cam.vfov     = 80;
-    cam.lookfrom = point3(0,0,9);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    cam.render(world);
-}
-
-void triangles() {
-    hittable_list world;
-
-    // Materials
-    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
-    auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
-    auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
-    auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
-    auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
-
-    // Quads
-    world.add(make_shared<triangle>(point3(-3,-2, 5), vec3(0, 0,-4), vec3(0, 4, 0), left_red));
-    world.add(make_shared<triangle>(point3(-2,-2, 0), vec3(4, 0, 0), vec3(0, 4, 0), back_green));
-    world.add(make_shared<triangle>(point3( 3,-2, 1), vec3(0, 0, 4), vec3(0, 4, 0), right_blue));
-    world.add(make_shared<triangle>(point3(-2, 3, 1), vec3(4, 0, 0), vec3(0, 0, 4), upper_orange));
-    world.add(make_shared<triangle>(point3(-2,-3, 5), vec3(4, 0, 0), vec3(0, 0,-4), lower_teal));
-
-    camera cam;
-
-    cam.aspect_ratio      = 1.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    cam.background        = color(0.70, 0.80, 1.00);
-
-    cam.vfov     = 80;
-    cam.lookfrom = point3(0,0,9);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    cam.render(world);
-}
-
-void simple_light() {
-    hittable_list world;
-
-    auto pertext = make_shared<noise_texture>();
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, make_shared<lambertian>(pertext)));
-    world.add(make_shared<sphere>(point3(0,2,0), 2, make_shared<lambertian>(pertext)));
-
-    // auto sphere_color = color(0.2, 0.2, 0.2);
-    // world.add(make_shared<sphere>(point3(0,-1000,0), 1000, make_shared<lambertian>(sphere_color)));
-    // auto marble_texture = make_shared<image_texture>("marble.jpg");
-    // auto marble_surface = make_shared<lambertian>(marble_texture);
-    // world.add(make_shared<sphere>(point3(0,2,0), 2, marble_surface));
-
-    auto difflight = make_shared<diffuse_light>(color(4,4,4));
-    world.add(make_shared<sphere>(point3(0,7,0), 2, difflight));
-    world.add(make_shared<quad>(point3(3,1,-2), vec3(2,0,0), vec3(0,2,0), difflight));
-
-    camera cam;
-
-    cam.aspect_ratio      = 16.0 / 9.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    cam.background        = color(0,0,0);
-
-    cam.vfov     = 20;
-    cam.lookfrom = point3(26,3,6);
-    cam.lookat   = point3(0,2,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    cam.render(world);
-}
-
-void cornell_box() {
-    // this will be very noisy, since the light source is very small
-    hittable_list world;
-
-    auto red   = make_shared<lambertian>(color(.65, .05, .05));
-    auto white = make_shared<lambertian>(color(.73, .73, .73));
-    auto green = make_shared<lambertian>(color(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(color(15, 15, 15));
-
-    world.add(make_shared<quad>(point3(555,0,0), vec3(0,555,0), vec3(0,0,555), green));
-    world.add(make_shared<quad>(point3(0,0,0), vec3(0,555,0), vec3(0,0,555), red));
-    world.add(make_shared<quad>(point3(343, 554, 332), vec3(-130,0,0), vec3(0,0,-105), light));
-    world.add(make_shared<quad>(point3(0,0,0), vec3(555,0,0), vec3(0,0,555), white));
-    world.add(make_shared<quad>(point3(555,555,555), vec3(-555,0,0), vec3(0,0,-555), white));
-    world.add(make_shared<quad>(point3(0,0,555), vec3(555,0,0), vec3(0,555,0), white));
-
-    // world.add(box(point3(130, 0, 65), point3(295, 165, 230), white));
-    // world.add(box(point3(265, 0, 295), point3(430, 330, 460), white));
-    shared_ptr<hittable> box1 = box(point3(0,0,0), point3(165,330,165), white);
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, vec3(265,0,295));
-    world.add(box1);
-
-    shared_ptr<hittable> box2 = box(point3(0,0,0), point3(165,165,165), white);
-    box2 = make_shared<rotate_y>(box2, -18);
-    box2 = make_shared<translate>(box2, vec3(130,0,65));
-    world.add(box2);
-
-    camera cam;
-
-    cam.aspect_ratio      = 1.0;
-    cam.image_width       = 600;
-    cam.samples_per_pixel = 200;
-    cam.max_depth         = 50;
-    cam.background        = color(0,0,0);
-
-    cam.vfov     = 40;
-    cam.lookfrom = point3(278, 278, -800);
-    cam.lookat   = point3(278, 278, 0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    cam.render(world);
-}
-
-void cornell_smoke() {
-    hittable_list world;
-
-    auto red   = make_shared<lambertian>(color(.65, .05, .05));
-    auto white = make_shared<lambertian>(color(.73, .73, .73));
-    auto green = make_shared<lambertian>(color(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(color(7, 7, 7));
-
-    world.add(make_shared<quad>(point3(555,0,0), vec3(0,555,0), vec3(0,0,555), green));
-    world.add(make_shared<quad>(point3(0,0,0), vec3(0,555,0), vec3(0,0,555), red));
-    world.add(make_shared<quad>(point3(113,554,127), vec3(330,0,0), vec3(0,0,305), light));
-    world.add(make_shared<quad>(point3(0,555,0), vec3(555,0,0), vec3(0,0,555), white));
-    world.add(make_shared<quad>(point3(0,0,0), vec3(555,0,0), vec3(0,0,555), white));
-    world.add(make_shared<quad>(point3(0,0,555), vec3(555,0,0), vec3(0,555,0), white));
-
-    shared_ptr<hittable> box1 = box(point3(0,0,0), point3(165,330,165), white);
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, vec3(265,0,295));
-
-    shared_ptr<hittable> box2 = box(point3(0,0,0), point3(165,165,165), white);
-    box2 = make_shared<rotate_y>(box2, -18);
-    box2 = make_shared<translate>(box2, vec3(130,0,65));
-
-    world.add(make_shared<constant_medium>(box1, 0.01, color(0,0,0)));
-    world.add(make_shared<constant_medium>(box2, 0.01, color(1,1,1)));
-
-    camera cam;
-
-    cam.aspect_ratio      = 1.0;
-    cam.image_width       = 600;
-    cam.samples_per_pixel = 200;
-    cam.max_depth         = 50;
-    cam.background        = color(0,0,0);
-
-    cam.vfov     = 40;
-    cam.lookfrom = point3(278, 278, -800);
-    cam.lookat   = point3(278, 278, 0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    cam.render(world);
-}
-
-void mesh_scene_nefertiti() {
-    hittable_list world;
-
-    auto difflight = make_shared<diffuse_light>(color(4,4,4));
-    world.add(make_shared<sphere>(point3(0,5,0), 2, difflight));
-    world.add(make_shared<quad>(point3(4,0,0), vec3(2,0,0), vec3(0,2,0), difflight));
-
-    auto pertext = make_shared<noise_texture>();
-    world.add(make_shared<sphere>(point3(0,-1000,0), 996, make_shared<lambertian>(pertext)));
-
-    // Materials 
-    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
-    // auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
-    // auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
-    // auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
-    // auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
-
-    // MESH LOGIC
-    mesh_loader loader = mesh_loader();
-    mesh nefertiti_mesh;
-    loader.load("./mesh/Nefertiti.obj", nefertiti_mesh);
-    hittable_list nefertiti_obj;
-    nefertiti_mesh.create_object(nefertiti_obj, left_red, 1);
-    world.add(make_shared<hittable_list>(nefertiti_obj));
-
-    camera cam;
-
-    cam.aspect_ratio      = 1.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    // cam.background        = color(0.70, 0.80, 1.00);
-    cam.background        = color(0.0, 0.0, 0.0);
-
-    cam.vfov     = 70;
-    cam.lookfrom = point3(-5,0,12);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    // cam.render(world);
-    cam.display(world);
+    if (!have_scene && !loader.load_builtin("final_scene", s)) return false;
+    if (!output_path.empty()) s.cam.output_path = output_path;
+    for (const auto& o : overrides)
+        if (!scene_loader::set_option(s, o.first, o.second)) return false;
+    if (interactive) {
+        if (s.cam.output_path.empty() || s.cam.output_path == "-") {
+            clog << "ERROR: The interactive preview needs an output path (-o preview.png).\n";
+            return false;
+        }
+        if (s.anim && !scene_loader::set_frame(s, first_frame)) return false;
+        interactive_preview preview;
+        preview.control_path = control_path;
+        preview.run(s);
+        return true;
+    }
+    if (s.anim) return render_sequence(s, first_frame, last_frame);
+    return s.render();
 }
 
-void mesh_scene_dragon() {
-    hittable_list world;
-
-    auto difflight = make_shared<diffuse_light>(color(4,4,4));
-    world.add(make_shared<sphere>(point3(0,90,0), 20, difflight));
-    world.add(make_shared<quad>(point3(80,0,0), vec3(40,0,0), vec3(0,40,0), difflight));
-
-    auto pertext = make_shared<noise_texture>();
-    world.add(make_shared<sphere>(point3(0,-1000,0), 940, make_shared<lambertian>(pertext)));
-
-    // Materials 
-    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
-    // auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
-    // auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
-    // auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
-    // auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
-
-    mesh_loader loader = mesh_loader();
-    mesh dragon_mesh;
-    loader.load("./mesh/xyzrgb_dragon.obj", dragon_mesh);
-    hittable_list dragon_obj;
-    dragon_mesh.create_object(dragon_obj, left_red, 1);
-    world.add(make_shared<hittable_list>(dragon_obj));
-
-    camera cam;
-
-    cam.aspect_ratio      = 1.0;
-    cam.image_width       = 400;
-    cam.samples_per_pixel = 100;
-    cam.max_depth         = 50;
-    // cam.background        = color(0.70, 0.80, 1.00);
-    cam.background        = color(0.0, 0.0, 0.0);
-
-    cam.vfov     = 70;
-    cam.lookfrom = point3(-100,0,100);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    // cam.render(world);
-    cam.display(world);
+bool run_batch(const string& path, scene_loader& loader) {
+    ifstream jobs(path);
+    if (!jobs) {
+        clog << "ERROR: Could not open jobs file '" << path << "'.\n";
+        return false;
+    }
+    int failed = 0, count = 0;
+    string line;
+    while (getline(jobs, line)) {
+        auto comment = line.find('#');
+        if (comment != string::npos) line.erase(comment);
+        vector<string> args;
+        istringstream tokens(line);
+        string token;
+        while (tokens >> token) args.push_back(token);
+        if (args.empty()) continue;
+
+        count++;
+        clog << "Job " << count << ": " << line << "\n";
+        if (!run_job(args, loader)) failed++;
+    }
+    clog << count - failed << " of " << count << " jobs done\n";
+    return failed == 0;
 }
 
-void final_scene(int image_width, int samples_per_pixel, int max_depth) {
-    hittable_list boxes1;
-    auto ground = make_shared<lambertian>(color(0.48, 0.83, 0.53));
-
-    int boxes_per_side = 20;
-    for (int i = 0; i < boxes_per_side; i++) {
-        for (int j = 0; j < boxes_per_side; j++) {
-            auto w = 100.0;
-            auto x0 = -1000.0 + i*w;
-            auto z0 = -1000.0 + j*w;
-            auto y0 = 0.0;
-            auto x1 = x0 + w;
-            auto y1 = random_double(1,101);
-            auto z1 = z0 + w;
-
-            boxes1.add(box(point3(x0,y0,z0), point3(x1,y1,z1), ground));
+int main(int argc, char** argv) {
+    vector<string> args(argv + 1, argv + argc);
+    while (args.size() >= 2 && (args[0] == "--bvh" || args[0] == "--bvh-width")) {
+        bvh_settings& bvh = bvh_node::default_settings;
+        if (args[0] == "--bvh-width") {
+            if (args[1] == "2" || args[1] == "4" || args[1] == "8") bvh.width = stoi(args[1]);
+            else {
+                clog << "ERROR: A BVH node has 2, 4 or 8 children, not '" << args[1] << "'.\n";
+                return 1;
+            }
+        } else if (args[1] == "sah") bvh.split = bvh_split::sah;
+        else if (args[1] == "lbvh") bvh.split = bvh_split::lbvh;
+        else if (args[1] == "median") bvh.split = bvh_split::median;
+        else {
+            clog << "ERROR: Unknown BVH builder '" << args[1] << "' (use sah, lbvh or median).\n";
+            return 1;
         }
+        args.erase(args.begin(), args.begin() + 2);
     }
-
-    hittable_list world;
-
-    world.add(make_shared<bvh_node>(boxes1));
-
-    auto light = make_shared<diffuse_light>(color(7, 7, 7));
-    world.add(make_shared<quad>(point3(123,554,147), vec3(300,0,0), vec3(0,0,265), light));
-
-    auto center1 = point3(400, 400, 200);
-    auto center2 = center1 + vec3(30,0,0);
-    auto sphere_material = make_shared<lambertian>(color(0.7, 0.3, 0.1));
-    world.add(make_shared<sphere>(center1, center2, 50, sphere_material));
-
-    world.add(make_shared<sphere>(point3(260, 150, 45), 50, make_shared<dielectric>(1.5)));
-    world.add(make_shared<sphere>(
-        point3(0, 150, 145), 50, make_shared<metal>(color(0.8, 0.8, 0.9), 1.0)
-    ));
-
-    auto boundary = make_shared<sphere>(point3(360,150,145), 70, make_shared<dielectric>(1.5));
-    world.add(boundary);
-    world.add(make_shared<constant_medium>(boundary, 0.2, color(0.2, 0.4, 0.9)));
-    boundary = make_shared<sphere>(point3(0,0,0), 5000, make_shared<dielectric>(1.5));
-    world.add(make_shared<constant_medium>(boundary, .0001, color(1,1,1)));
-
-    auto emat = make_shared<lambertian>(make_shared<image_texture>("earthmap.jpg"));
-    world.add(make_shared<sphere>(point3(400,200,400), 100, emat));
-    // auto pertext = make_shared<noise_texture>(0.1);
-    auto pertext = make_shared<noise_texture>();
-    world.add(make_shared<sphere>(point3(220,280,300), 80, make_shared<lambertian>(pertext)));
-
-    hittable_list boxes2;
-    auto white = make_shared<lambertian>(color(.73, .73, .73));
-    int ns = 1000;
-    for (int j = 0; j < ns; j++) {
-        boxes2.add(make_shared<sphere>(point3::random(0,165), 10, white));
+    scene_loader loader;
+    if (!args.empty() && args[0] == "--batch") {
+        if (args.size() != 2) {
+            clog << "Usage: ./main --batch <jobs file>\n";
+            return 1;
+        }
+        return run_batch(args[1], loader) ? 0 : 1;
     }
-
-    world.add(make_shared<translate>(
-        make_shared<rotate_y>(
-            make_shared<bvh_node>(boxes2), 15),
-            vec3(-100,270,395)
-        )
-    );
-
-    camera cam;
-
-    cam.aspect_ratio      = 1.0;
-    cam.image_width       = image_width;
-    cam.samples_per_pixel = samples_per_pixel;
-    cam.max_depth         = max_depth;
-    cam.background        = color(0,0,0);
-
-    cam.vfov     = 40;
-    cam.lookfrom = point3(478, 278, -600);
-    cam.lookat   = point3(278, 278, 0);
-    cam.vup      = vec3(0,1,0);
-
-    cam.defocus_angle = 0;
-
-    // cam.render(world);
-    cam.display(world);
+    return run_job(args, loader) ? 0 : 1;
 }
-
-int main() { // Easy switch between scenes
-    switch (13)
-    {
-    case 1:
-        main_schene();
-        break;
-    case 2:
-        random_spheres();
-        break;
-    case 3:
-        two_spheres();
-        break;
-    case 4:
-        earth();
-        break;
-    case 5:
-        two_perlin_spheres();
-        break;
-    case 6:
-        quads();
-        break;
-    case 7:
-        simple_light();
-        break;
-    case 8:
-        cornell_box();
-        break;
-    case 9:
-        cornell_smoke();
-        break;
-    case 10:
-        triangles();
-        break;
-    case 11:
-        mesh_scene_nefertiti();
-        break;
-    case 12:
-        mesh_scene_dragon();
-        break;
-    case 13:
-        final_scene(800, 10, 20);
-        break;
-    default:
-        break;
-    }
-}
\ No newline at end of file
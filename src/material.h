@@ -9,6 +9,8 @@
 class material { // abstract class
 
     public:
+        string name = ""; // Set by scene files, names the material's light buffer (see camera::light_aov_path)
+
         virtual ~material() = default;
 
         virtual bool scatter(
@@ -19,6 +21,18 @@ class material { // abstract class
             ) const = 0;
 
         virtual color emitted(double u, double v, const point3& p) const { return color(0,0,0); }
+
+        virtual double scattering_pdf(const ray& r_in, const hit_record& rec, const ray& scattered) const {
+            // Probability density (per solid angle) with which scatter() picks the direction of scattered.
+            // --> attenuation * scattering_pdf is the BRDF times the cosine, which is what light sampling needs.
+            // --> 0 for materials that scatter into a single direction (metal, dielectric), they cannot use light samples.
+            return 0;
+        }
+
+        virtual color surface_albedo(const hit_record& rec) const {
+            // Surface color as seen by the denoiser (no lighting), white for materials without one
+            return color(1,1,1);
+        }
 };
 
 class lambertian : public material { // type of surface (calculations based on reflectance), we the light scatters everytime for simplicity
@@ -44,6 +58,14 @@ class lambertian : public material { // type of surface (calculations based on r
             return true;
         }
 
+        double scattering_pdf(const ray& r_in, const hit_record& rec, const ray& scattered) const override {
+            // normal + random_unit_vector() is cosine distributed
+            auto cos_theta = dot(rec.normal, unit_vector(scattered.direction()));
+            return cos_theta < 0 ? 0 : cos_theta/pi;
+        }
+
+        color surface_albedo(const hit_record& rec) const override { return albedo->value(rec.u, rec.v, rec.p); }
+
     private:
         shared_ptr<texture> albedo;
 };
@@ -63,6 +85,8 @@ class metal : public material { // reflects ligth with the incoming angle (vec3.
             // --> the scattered lies within the object, so object absorbs the light!
         }
 
+        color surface_albedo(const hit_record& rec) const override { return albedo; }
+
     private:
         color albedo;
         double fuzz;
@@ -147,6 +171,12 @@ class isotropic : public material {
             return true;
         } 
 
+        double scattering_pdf(const ray& r_in, const hit_record& rec, const ray& scattered) const override {
+            return 1 / (4*pi);
+        }
+
+        color surface_albedo(const hit_record& rec) const override { return albedo->value(rec.u, rec.v, rec.p); }
+
     private:
         shared_ptr<texture> albedo;
 };
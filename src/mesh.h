@@ -6,11 +6,17 @@
 class triangle : public quad {
 
     public:
-        using quad::quad;
-        using quad::set_bounding_box;
+        triangle(const point3 &_Q, const vec3 &_u, const vec3 &_v, shared_ptr<material> m) : quad(_Q, _u, _v, m) {
+            set_bounding_box(); // the quad constructor can only call quad's version
+        }
         using quad::hit;
         using quad::bounding_box;
 
+        void set_bounding_box() override {
+            // The three corners Q, Q+u & Q+v, the fourth one of the parallelogram is not part of the triangle
+            bbox = aabb(aabb(Q, Q + u), aabb(Q, Q + v)).pad();
+        }
+
         bool is_interior(double a, double b, hit_record& rec) const {
             if ((a < 0) || (b < 0) || (1 < a+b))
                 return false;
@@ -20,6 +26,23 @@ class triangle : public quad {
             return true;
         }
 
+        render_stats::counter stats_counter() const override { return render_stats::triangle_tests; }
+
+        double pdf_value(const point3& origin, const vec3& direction) const override {
+            return 2 * quad::pdf_value(origin, direction); // half the area of the quad
+        }
+
+        vec3 random(const point3& origin) const override {
+            // Uniform point of the parallelogram, mirrored into the triangle if it lies in the other half
+            auto a = random_double();
+            auto b = random_double();
+            if (a + b > 1) {
+                a = 1 - a;
+                b = 1 - b;
+            }
+            return (Q + a*u + b*v) - origin;
+        }
+
 };
 
 class mesh {
@@ -15,16 +15,19 @@ class quad : public hittable { // 2D object defined by base Q, and vectors u & v
             normal = unit_vector(n);
             D = dot(normal, Q);
             w = n / dot(n, n);
+            area = n.length();
 
             set_bounding_box();
         }
 
         // Functions
         virtual void set_bounding_box() { // abstract method, gotta define for other 2D objects
-            bbox = aabb(Q, Q + u + v).pad();
+            // Q & Q+u+v alone miss the other two corners whenever u & v point in opposite directions along an axis
+            bbox = aabb(aabb(Q, Q + u + v), aabb(Q + u, Q + v)).pad();
         }
 
         bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            RT_STAT_ADD(stats_counter(), 1);
             auto denom = dot(normal, r.direction());
 
             // No hit if the ray is parallel to the plane.
@@ -47,12 +50,62 @@ class quad : public hittable { // 2D object defined by base Q, and vectors u & v
 
             rec.t = t;
             rec.p = intersection;
-            rec.mat = mat;
+            rec.mat = mat.get();
             rec.set_face_normal(r, normal);
 
+            RT_STAT_ADD(render_stats::hits_of(stats_counter()), 1);
             return true;
         }
 
+        void hit_packet(ray_packet& packet, uint32_t mask, hit_record* recs) const override {
+            // The plane intersection & plane coordinates of hit() for simd_double::width rays at a time.
+            // --> is_interior (quad or triangle) is then asked per ray, only for the rays that hit the plane in range.
+            RT_STAT_ADD(stats_counter(), ray_packet::count(mask));
+            for (int k = 0; k < packet.size; k += simd_double::width) {
+                int lanes = (mask >> k) & simd_double::lane_mask;
+                if (lanes == 0) continue;
+                simd_double dx = simd_double::load(packet.dir[0] + k);
+                simd_double dy = simd_double::load(packet.dir[1] + k);
+                simd_double dz = simd_double::load(packet.dir[2] + k);
+                simd_double ox = simd_double::load(packet.orig[0] + k);
+                simd_double oy = simd_double::load(packet.orig[1] + k);
+                simd_double oz = simd_double::load(packet.orig[2] + k);
+
+                auto denom = normal.x()*dx + normal.y()*dy + normal.z()*dz;
+                lanes &= ~(abs(denom) < 1e-8); // parallel to the plane
+                auto t = (D - (normal.x()*ox + normal.y()*oy + normal.z()*oz)) / denom;
+                lanes &= (simd_double::load(packet.t_min + k) <= t) & (t <= simd_double::load(packet.t_max + k));
+                if (lanes == 0) continue;
+
+                // planar_hitpt_vector = r.at(t) - Q
+                auto px = (ox + t*dx) - Q.x();
+                auto py = (oy + t*dy) - Q.y();
+                auto pz = (oz + t*dz) - Q.z();
+                auto alpha = w.x()*(py*v.z() - pz*v.y()) + w.y()*(pz*v.x() - px*v.z()) + w.z()*(px*v.y() - py*v.x());
+                auto beta = w.x()*(u.y()*pz - u.z()*py) + w.y()*(u.z()*px - u.x()*pz) + w.z()*(u.x()*py - u.y()*px);
+
+                alignas(32) double ts[simd_double::width], alphas[simd_double::width], betas[simd_double::width];
+                t.store(ts);
+                alpha.store(alphas);
+                beta.store(betas);
+                for (int l = 0; l < simd_double::width; l++) {
+                    if (!(lanes & (1 << l))) continue;
+                    hit_record temp_rec; // is_interior writes u & v, recs[k+l] must stay intact on a miss
+                    if (!is_interior(alphas[l], betas[l], temp_rec))
+                        continue;
+                    const ray& r = packet.rays[k+l];
+                    temp_rec.t = ts[l];
+                    temp_rec.p = r.at(ts[l]);
+                    temp_rec.mat = mat.get();
+                    temp_rec.set_face_normal(r, normal);
+                    recs[k+l] = temp_rec;
+                    RT_STAT_ADD(render_stats::hits_of(stats_counter()), 1);
+                    packet.t_max[k+l] = ts[l];
+                    packet.hit[k+l] = true;
+                }
+            }
+        }
+
         virtual bool is_interior(double a, double b, hit_record& rec) const {
             // --> Only function (apart from set_bounding_box) to change for arbitrary 2D objects 
             // --> now it's way easier to implement triagles
@@ -71,11 +124,32 @@ class quad : public hittable { // 2D object defined by base Q, and vectors u & v
             return bbox;
         }
 
-    private:
+        virtual render_stats::counter stats_counter() const { return render_stats::quad_tests; } // which tests hit() counts
+
+        double pdf_value(const point3& origin, const vec3& direction) const override {
+            // Uniform sampling over the area, converted to solid angle: distance^2 / (cosine * area)
+            hit_record rec;
+            if (!this->hit(ray(origin, direction), interval(0.001, infinity), rec))
+                return 0;
+
+            auto distance_squared = rec.t * rec.t * direction.length_squared();
+            auto cosine = fabs(dot(direction, rec.normal) / direction.length());
+            return distance_squared / (cosine * area);
+        }
+
+        vec3 random(const point3& origin) const override {
+            auto p = Q + (random_double() * u) + (random_double() * v);
+            return p - origin;
+        }
+
+    protected: // triangle samples & bounds its own half of the parallelogram
         point3 Q;
         vec3 u, v;
-        shared_ptr<material> mat;
+        double area;
         aabb bbox;
+
+    private:
+        shared_ptr<material> mat;
         vec3 normal;
         double D;
         vec3 w;
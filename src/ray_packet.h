@@ -0,0 +1,152 @@
+// Ray packets --> a handful of coherent rays traced together
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "interval.h"
+#include "ray.h"
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class simd_double {
+    // The same operation on several doubles at once: 4 with AVX, 2 with SSE2, 1 without either.
+    // --> Comparisons return a bitmask with one bit per lane, which is what the packet code works with.
+
+    public:
+#if defined(__AVX__)
+        static const int width = 4;
+        __m256d v;
+
+        simd_double(__m256d x) : v(x) {}
+        simd_double(double x) : v(_mm256_set1_pd(x)) {}
+        static simd_double load(const double* p) { return _mm256_load_pd(p); }
+        static simd_double load(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); } // widened to doubles
+        void store(double* p) const { _mm256_store_pd(p, v); }
+
+        friend simd_double operator+(simd_double a, simd_double b) { return _mm256_add_pd(a.v, b.v); }
+        friend simd_double operator-(simd_double a, simd_double b) { return _mm256_sub_pd(a.v, b.v); }
+        friend simd_double operator*(simd_double a, simd_double b) { return _mm256_mul_pd(a.v, b.v); }
+        friend simd_double operator/(simd_double a, simd_double b) { return _mm256_div_pd(a.v, b.v); }
+        friend simd_double sqrt(simd_double a) { return _mm256_sqrt_pd(a.v); }
+        friend simd_double abs(simd_double a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v); }
+        // b<a ? b : a and a<b ? b : a, like std::min & std::max
+        friend simd_double min(simd_double a, simd_double b) { return _mm256_blendv_pd(a.v, b.v, _mm256_cmp_pd(b.v, a.v, _CMP_LT_OQ)); }
+        friend simd_double max(simd_double a, simd_double b) { return _mm256_blendv_pd(a.v, b.v, _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)); }
+        friend int operator<(simd_double a, simd_double b) { return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)); }
+        friend int operator<=(simd_double a, simd_double b) { return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)); }
+        static simd_double select(int mask, simd_double a, simd_double b) { // lanes of a where mask is set, else b
+            __m256d on = _mm256_castsi256_pd(_mm256_set_epi64x((mask & 8) ? -1 : 0, (mask & 4) ? -1 : 0,
+                                                               (mask & 2) ? -1 : 0, (mask & 1) ? -1 : 0));
+            return _mm256_blendv_pd(b.v, a.v, on);
+        }
+#elif defined(__SSE2__)
+        static const int width = 2;
+        __m128d v;
+
+        simd_double(__m128d x) : v(x) {}
+        simd_double(double x) : v(_mm_set1_pd(x)) {}
+        static simd_double load(const double* p) { return _mm_load_pd(p); }
+        static simd_double load(const float* p) { // widened to doubles
+            return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+        }
+        void store(double* p) const { _mm_store_pd(p, v); }
+
+        friend simd_double operator+(simd_double a, simd_double b) { return _mm_add_pd(a.v, b.v); }
+        friend simd_double operator-(simd_double a, simd_double b) { return _mm_sub_pd(a.v, b.v); }
+        friend simd_double operator*(simd_double a, simd_double b) { return _mm_mul_pd(a.v, b.v); }
+        friend simd_double operator/(simd_double a, simd_double b) { return _mm_div_pd(a.v, b.v); }
+        friend simd_double sqrt(simd_double a) { return _mm_sqrt_pd(a.v); }
+        friend simd_double abs(simd_double a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a.v); }
+        // b<a ? b : a and a<b ? b : a, like std::min & std::max
+        friend simd_double min(simd_double a, simd_double b) { return blend(a.v, b.v, _mm_cmplt_pd(b.v, a.v)); }
+        friend simd_double max(simd_double a, simd_double b) { return blend(a.v, b.v, _mm_cmplt_pd(a.v, b.v)); }
+        friend int operator<(simd_double a, simd_double b) { return _mm_movemask_pd(_mm_cmplt_pd(a.v, b.v)); }
+        friend int operator<=(simd_double a, simd_double b) { return _mm_movemask_pd(_mm_cmple_pd(a.v, b.v)); }
+        static simd_double select(int mask, simd_double a, simd_double b) { // lanes of a where mask is set, else b
+            __m128d on = _mm_castsi128_pd(_mm_set_epi64x((mask & 2) ? -1 : 0, (mask & 1) ? -1 : 0));
+            return blend(b.v, a.v, on);
+        }
+
+    private:
+        static __m128d blend(__m128d a, __m128d b, __m128d take_b) {
+            return _mm_or_pd(_mm_and_pd(take_b, b), _mm_andnot_pd(take_b, a));
+        }
+    public:
+#else
+        static const int width = 1;
+        double v;
+
+        simd_double(double x) : v(x) {}
+        static simd_double load(const double* p) { return *p; }
+        static simd_double load(const float* p) { return *p; }
+        void store(double* p) const { *p = v; }
+
+        friend simd_double operator+(simd_double a, simd_double b) { return a.v + b.v; }
+        friend simd_double operator-(simd_double a, simd_double b) { return a.v - b.v; }
+        friend simd_double operator*(simd_double a, simd_double b) { return a.v * b.v; }
+        friend simd_double operator/(simd_double a, simd_double b) { return a.v / b.v; }
+        friend simd_double sqrt(simd_double a) { return std::sqrt(a.v); }
+        friend simd_double abs(simd_double a) { return std::fabs(a.v); }
+        friend simd_double min(simd_double a, simd_double b) { return (b.v < a.v) ? b.v : a.v; }
+        friend simd_double max(simd_double a, simd_double b) { return (a.v < b.v) ? b.v : a.v; }
+        friend int operator<(simd_double a, simd_double b) { return a.v < b.v; }
+        friend int operator<=(simd_double a, simd_double b) { return a.v <= b.v; }
+        static simd_double select(int mask, simd_double a, simd_double b) { return mask ? a : b; }
+#endif
+
+        static const int lane_mask = (1 << width) - 1;
+};
+
+class ray_packet {
+    // Up to max_size rays (a 4x4 block of neighbouring pixels) in structure-of-arrays layout, so that simd_double
+    // --> can load the x (y, z) components of several rays at once. Every function taking a packet also takes a
+    // --> mask: bit k set means ray k still takes part. t_max[k] shrinks to the closest hit found so far, just like
+    // --> closest_so_far in hittable_list::hit.
+
+    public:
+        static const int max_size = 16;
+
+        int size = 0;
+        ray rays[max_size];
+        alignas(32) double orig[3][max_size];
+        alignas(32) double dir[3][max_size];
+        alignas(32) double t_min[max_size];
+        alignas(32) double t_max[max_size];
+        bool hit[max_size];
+
+        // Constructors
+        ray_packet() {
+            // Unused lanes get an empty interval, so they never hit anything
+            for (int k = 0; k < max_size; k++) {
+                for (int a = 0; a < 3; a++) orig[a][k] = dir[a][k] = 1.0;
+                t_min[k] = 1.0;
+                t_max[k] = 0.0;
+                hit[k] = false;
+            }
+        }
+
+        // Functions
+        void add(const ray& r, interval ray_t) {
+            int k = size++;
+            rays[k] = r;
+            for (int a = 0; a < 3; a++) {
+                orig[a][k] = r.origin()[a];
+                dir[a][k] = r.direction()[a];
+            }
+            t_min[k] = ray_t.min;
+            t_max[k] = ray_t.max;
+            hit[k] = false;
+        }
+
+        uint32_t full_mask() const { return (size >= 32) ? ~0u : (1u << size) - 1; }
+
+        static int count(uint32_t mask) { return __builtin_popcount(mask); }
+};
+
+#endif
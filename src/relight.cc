@@ -0,0 +1,92 @@
+// Relighting --> recombines the light buffers of a render (camera::light_aov_path) with new light intensities & colors
+// Usage: ./relight <path>.lights [<light>=<scale> | <light>=r,g,b ...] [--list] -o image.(ppm|pfm|png)
+// --> Light transport is linear in the emitted light, so the image is the sum of the light buffers, each multiplied
+// --> with the change of its light: a scale multiplies the light as it was rendered (1 keeps it, 0 turns it off),
+// --> r,g,b scales every channel on its own (a new color). Lights without a setting stay as they were. The
+// --> background (or sky) is the light named 'background'. --list prints the names of the lights.
+
+#include "image_writer.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    string list_path = "", output_path = "";
+    bool list_only = false;
+    map<string, color> scales;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto eq = arg.find('=');
+        if (arg == "-o" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (arg == "--list") {
+            list_only = true;
+        } else if (eq != string::npos) {
+            double r, g, b;
+            char rest;
+            string value = arg.substr(eq + 1);
+            int n = sscanf(value.c_str(), "%lf,%lf,%lf%c", &r, &g, &b, &rest);
+            if (n == 1) scales[arg.substr(0, eq)] = color(r, r, r);
+            else if (n == 3) scales[arg.substr(0, eq)] = color(r, g, b);
+            else {
+                cerr << "Invalid light setting '" << arg << "' (use name=scale or name=r,g,b)\n";
+                return 1;
+            }
+        } else if (list_path.empty()) {
+            list_path = arg;
+        } else {
+            cerr << "Unexpected argument '" << arg << "' (see the top of relight.cc)\n";
+            return 1;
+        }
+    }
+
+    ifstream list(list_path);
+    if (list_path.empty() || !list) {
+        cerr << "Could not open the list of light buffers '" << list_path << "'\n";
+        return 1;
+    }
+    vector<pair<string, string>> lights; // name, buffer file
+    string line;
+    while (getline(list, line)) {
+        string name, path;
+        if (istringstream(line) >> name >> path) lights.emplace_back(name, path);
+    }
+    if (list_only) {
+        for (const auto& light : lights) cout << light.first << '\n';
+        return 0;
+    }
+    if (output_path.empty()) {
+        cerr << "Missing output path (-o image.png)\n";
+        return 1;
+    }
+    for (const auto& s : scales) {
+        bool known = false;
+        for (const auto& light : lights) known = known || light.first == s.first;
+        if (!known) {
+            cerr << "There is no light '" << s.first << "' (see --list)\n";
+            return 1;
+        }
+    }
+
+    image result;
+    for (const auto& [name, path] : lights) {
+        image buffer;
+        if (!read_pfm(path, buffer)) return 1;
+        if (result.rgb.empty()) result = image(buffer.width, buffer.height);
+        if (buffer.width != result.width || buffer.height != result.height) {
+            cerr << "'" << path << "' has a different size than the other light buffers\n";
+            return 1;
+        }
+        auto scale = scales.count(name) ? scales[name] : color(1, 1, 1);
+        for (size_t k = 0; k < result.rgb.size(); k++)
+            result.rgb[k] += static_cast<float>(scale[k % 3]) * buffer.rgb[k];
+    }
+    return write_image(output_path, result) ? 0 : 1;
+}
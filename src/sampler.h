@@ -0,0 +1,219 @@
+// Random number generation for the render path
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cmath>
+#include <cstdint>
+
+class pcg32 {
+    // PCG32 generator (XSH-RR variant) --> https://www.pcg-random.org/
+    // --> 16 bytes of state, a multiply and an add per step, statistically much better than rand().
+    // --> inc selects one of 2^63 independent streams, advance() jumps ahead in O(log n).
+
+    public:
+        // Constructors
+        pcg32() { seed(0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL); }
+        pcg32(uint64_t init_state, uint64_t init_seq) { seed(init_state, init_seq); }
+
+        // Functions
+        void seed(uint64_t init_state, uint64_t init_seq) {
+            state = 0u;
+            inc = (init_seq << 1u) | 1u; // increment has to be odd
+            next_uint();
+            state += init_state;
+            next_uint();
+        }
+
+        uint32_t next_uint() {
+            uint64_t old_state = state;
+            state = old_state * multiplier + inc;
+            uint32_t xorshifted = static_cast<uint32_t>(((old_state >> 18u) ^ old_state) >> 27u);
+            uint32_t rot = static_cast<uint32_t>(old_state >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+        }
+
+        double next_double() {
+            // Returns a random real in [0,1).
+            return next_uint() * (1.0 / 4294967296.0);
+        }
+
+        void advance(uint64_t delta) {
+            // Jump ahead delta steps, equivalent to calling next_uint() delta times
+            // --> Brown, "Random Number Generation with Arbitrary Stride" (1994)
+            uint64_t cur_mult = multiplier, cur_plus = inc;
+            uint64_t acc_mult = 1u, acc_plus = 0u;
+            while (delta > 0) {
+                if (delta & 1) {
+                    acc_mult *= cur_mult;
+                    acc_plus = acc_plus * cur_mult + cur_plus;
+                }
+                cur_plus = (cur_mult + 1) * cur_plus;
+                cur_mult *= cur_mult;
+                delta /= 2;
+            }
+            state = acc_mult * state + acc_plus;
+        }
+
+        bool operator==(const pcg32& other) const { return state == other.state && inc == other.inc; }
+
+        uint64_t state; // public, so it can be stored in checkpoints
+        uint64_t inc;
+
+    private:
+        static const uint64_t multiplier = 0x5851f42d4c957f2dULL;
+};
+
+inline uint64_t mix_bits(uint64_t v) {
+    // 64-bit finalizer of splitmix64, turns nearby keys (pixel 7, pixel 8) into unrelated bit patterns
+    v ^= v >> 30;
+    v *= 0xbf58476d1ce4e5b9ULL;
+    v ^= v >> 27;
+    v *= 0x94d049bb133111ebULL;
+    v ^= v >> 31;
+    return v;
+}
+
+enum class sample_pattern {
+    independent, // every number on its own (PCG)
+    stratified,  // jittered grid: each pair of dimensions gets one sample per grid cell of the pixel
+    sobol        // Owen-scrambled 2D Sobol points, well distributed for any sample count
+};
+
+class sampler {
+    // Every random number used for a camera sample is keyed by (pixel, sample, dimension):
+    // --> (pixel, sample) picks the PCG stream, the dimension is the position within that stream.
+    // --> Thus a pixel's samples do not depend on which thread renders it or in which order, and
+    // --> renders are repeatable at any thread count.
+    // --> With the stratified & sobol patterns, dimensions 2k and 2k+1 together form a 2D point, and the points of a
+    // --> pixel's samples cover the unit square evenly instead of clumping. Each pair of dimensions is scrambled on
+    // --> its own ("padding"), so the callers only have to agree on which dimensions they use for what (see camera).
+
+    public:
+        uint64_t seed = 0; // Global seed, change it to get a different (but again repeatable) noise pattern
+        sample_pattern pattern = sample_pattern::independent;
+        int samples_per_pixel = 1; // Number of cells of the stratified grid
+
+        // Functions
+        void start_pixel_sample(uint64_t pixel_index, uint64_t sample_index) {
+            stream_key = mix_bits(seed ^ mix_bits(pixel_index + 0x9e3779b97f4a7c15ULL * (sample_index + 1)));
+            pixel = pixel_index;
+            sample = sample_index;
+            start_dimension(0);
+        }
+
+        void start_dimension(uint64_t dim) {
+            // Jump to a given dimension of the current pixel sample
+            rng.seed(stream_key, mix_bits(stream_key));
+            if (dim > 0) rng.advance(dim);
+            dimension = dim;
+        }
+
+        double get_1d() {
+            // The PCG stream always moves along, so start_dimension() finds the same position for every pattern
+            auto dim = dimension++;
+            auto u = rng.next_double();
+            switch (pattern) {
+                case sample_pattern::stratified: return stratified_1d(dim, u);
+                case sample_pattern::sobol:      return sobol_1d(dim);
+                default:                         return u;
+            }
+        }
+
+        uint64_t current_dimension() const { return dimension; }
+
+    private:
+        pcg32 rng;
+        uint64_t stream_key = 0;
+        uint64_t pixel = 0;
+        uint64_t sample = 0;
+        uint64_t dimension = 0;
+
+        uint32_t pair_key(uint64_t dim, uint64_t salt) const {
+            // Same for all samples of a pixel, different for every pixel and pair of dimensions
+            return static_cast<uint32_t>(mix_bits(mix_bits(seed ^ mix_bits(pixel + 1)) + 4*(dim/2) + salt));
+        }
+
+        double stratified_1d(uint64_t dim, double jitter) const {
+            // The grid has nx*ny >= samples_per_pixel cells. Sample k takes the cell permute(k) (a different
+            // --> permutation for every pair of dimensions, so that the pairs are not correlated), and jitter
+            // --> picks the position inside the cell.
+            auto n = static_cast<uint32_t>(samples_per_pixel < 1 ? 1 : samples_per_pixel);
+            auto nx = static_cast<uint32_t>(ceil(sqrt(static_cast<double>(n))));
+            auto ny = (n + nx - 1) / nx;
+            if (sample >= static_cast<uint64_t>(nx) * ny) return jitter; // more samples than cells
+
+            auto cell = permute(static_cast<uint32_t>(sample), nx * ny, pair_key(dim, 0));
+            double x = (dim % 2 == 0) ? (cell % nx + jitter) / nx : (cell / nx + jitter) / ny;
+            return fmin(x, 0x1.fffffffffffffp-1);
+        }
+
+        double sobol_1d(uint64_t dim) const {
+            // Burley, "Practical Hash-based Owen Scrambling" (2020): shuffle the sample order, take the 2D Sobol
+            // --> point (the first two Sobol dimensions), then Owen-scramble each of its coordinates.
+            auto index = nested_uniform_scramble(static_cast<uint32_t>(sample), pair_key(dim, 0));
+            uint32_t x = (dim % 2 == 0) ? reverse_bits(index) : sobol_dimension_1(index);
+            x = nested_uniform_scramble(x, pair_key(dim, 1 + dim % 2));
+            return x * (1.0 / 4294967296.0);
+        }
+
+        static uint32_t reverse_bits(uint32_t x) {
+            x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+            x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+            x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+            x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+            return (x >> 16) | (x << 16);
+        }
+
+        static uint32_t sobol_dimension_1(uint32_t index) {
+            // Direction numbers of the second Sobol dimension: v_0 = 2^31, v_k = v_(k-1) ^ (v_(k-1) >> 1)
+            uint32_t result = 0;
+            for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+                if (index & 1) result ^= v;
+            return result;
+        }
+
+        static uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+            // Owen scrambling: flipping a bit depends on all the bits above it (Laine-Karras hash on the reversed bits)
+            x = reverse_bits(x);
+            x += seed;
+            x ^= x * 0x6c50b47cu;
+            x ^= x * 0xb82f1e52u;
+            x ^= x * 0xc7afe638u;
+            x ^= x * 0x8d22f6e6u;
+            return reverse_bits(x);
+        }
+
+        static uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+            // Random permutation of [0,l) selected by p, evaluated one element at a time
+            // --> Kensler, "Correlated Multi-Jittered Sampling" (2013)
+            uint32_t w = l - 1;
+            w |= w >> 1;
+            w |= w >> 2;
+            w |= w >> 4;
+            w |= w >> 8;
+            w |= w >> 16;
+            do {
+                i ^= p;             i *= 0xe170893d;
+                i ^= p >> 16;
+                i ^= (i & w) >> 4;
+                i ^= p >> 8;        i *= 0x0929eb3f;
+                i ^= p >> 23;
+                i ^= (i & w) >> 1;  i *= 1 | p >> 27;
+                                    i *= 0x6935fa69;
+                i ^= (i & w) >> 11; i *= 0x74dcb303;
+                i ^= (i & w) >> 2;  i *= 0x9e501cc3;
+                i ^= (i & w) >> 2;  i *= 0xc860a3df;
+                i &= w;
+                i ^= i >> 5;
+            } while (i >= l);
+            return (i + p) % l;
+        }
+};
+
+inline sampler& thread_sampler() {
+    // Each thread owns its sampler, so drawing random numbers needs neither locks nor shared state.
+    thread_local sampler s;
+    return s;
+}
+
+#endif
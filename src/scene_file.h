@@ -0,0 +1,622 @@
+// Scene description files --> scenes as text (objects, materials, textures & camera settings), loaded at run time
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "scenes.h"
+
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+class scene_loader {
+    // One statement per line, '#' starts a comment. The first word says what the line defines, the rest of the line
+    // --> are key=value parameters, vectors are written as x,y,z (without spaces):
+    //     texture  <name> solid color=..  |  checker scale=.. even=.. odd=..  |  image file=..  |  noise
+    //     material <name> lambertian color=..|texture=..  |  metal color=.. fuzz=..  |  dielectric ior=..
+    //                     |  light color=..|texture=..  |  isotropic color=..|texture=..
+    //     sphere   center=.. radius=.. material=.. [center2=..]   (center2: moving sphere, at center2 when time=1)
+    //     quad     q=.. u=.. v=.. material=..
+    //     triangle q=.. u=.. v=.. material=..
+    //     cuboid   center=.. size=.. material=.. [angles=degrees,degrees,degrees rotation=euler]
+    //     box      min=.. max=.. material=..
+    //     mesh     file=.. material=.. [scale=..]                 (.obj triangle mesh, gets a BVH of its own)
+    //     medium   density=.. color=..|texture=.. <shape line>    (smoke/fog, the shape is only its boundary)
+    //     camera   <key>=<value> ...                              (see set_option)
+    //     bvh      on|off                                         (BVH over the file's objects, on by default)
+    //     frames   <count>                                        (length of the sequence, see animation.h)
+    //     keyframe <frame> camera <key>=<value> ...               (lookfrom, lookat, vup, vfov, defocus_angle,
+    //                                                              focus_dist & background can be keyframed)
+    //     keyframe <frame> <object name> [rotate_y=..] [translate=..]
+    // --> Every shape also takes rotate_y=degrees and translate=x,y,z (applied in this order), and name=<name> to be
+    // --> referred to by keyframes. Spheres, quads and triangles with a light material (and no transform) are also
+    // --> sampled directly by the camera, animated objects never are.
+    // --> Files, meshes and image textures are cached: loading the same file again (e.g. in batch mode, with other
+    // --> camera settings) reuses its objects & BVH instead of parsing and building them again.
+
+    public:
+        // Functions
+        bool load(const string& path, scene& s) {
+            // Adds the objects of the scene file at path to s and applies its camera settings
+            auto cached = files.find(path);
+            if (cached == files.end()) {
+                ifstream file(path);
+                if (!file) {
+                    clog << "ERROR: Could not open scene file '" << path << "'.\n";
+                    return false;
+                }
+                file_entry entry;
+                if (!parse(file, path, entry)) return false;
+                cached = files.emplace(path, std::move(entry)).first;
+            }
+
+            const file_entry& entry = cached->second;
+            for (const auto& object : entry.world.objects) s.world.add(object);
+            for (const auto& light : entry.lights.objects) s.lights.add(light);
+            s.bvh_seconds += entry.bvh_seconds;
+            if (entry.anim.frame_count > 0) {
+                auto merged = s.anim ? make_shared<animation>(*s.anim) : make_shared<animation>(); // s.anim may be shared
+                merged->merge(entry.anim);
+                s.anim = merged;
+            }
+            for (const auto& option : entry.options)
+                if (!set_option(s, option.first, option.second)) return false; // checked while parsing already
+            return true;
+        }
+
+        bool load_builtin(const string& name, scene& s) {
+            // One of the scenes of scenes.h, by name (built once, then reused like a file)
+            auto cached = builtins.find(name);
+            if (cached == builtins.end()) {
+                for (const auto& entry : all_scenes()) {
+                    if (entry.name == name) cached = builtins.emplace(name, entry.build()).first;
+                }
+                if (cached == builtins.end()) {
+                    clog << "ERROR: There is no built-in scene '" << name << "'.\n";
+                    return false;
+                }
+            }
+            s = cached->second;
+            return s.complete;
+        }
+
+        static bool set_frame(scene& s, int frame) {
+            // Puts the camera & the animated objects of s where its keyframes have them at frame, call it on a copy
+            // --> of the loaded scene for every frame (copies share all objects and BVHs)
+            if (!s.anim) return true;
+            for (const auto& setting : s.anim->camera_at(frame))
+                if (!set_option(s, setting.first, setting.second)) return false;
+            s.anim->add_objects_at(frame, s.world);
+            return true;
+        }
+
+        static bool set_option(scene& s, const string& key, const string& value) {
+            // Camera (and scene) settings, shared by the 'camera' lines of scene files and the command line
+            camera& cam = s.cam;
+            bool ok = true;
+            string range; // what a value out of range should have been
+            auto number = [&](double& x) { ok = parse_number(value, x); };
+            auto positive = [&](double& x) { // > 0
+                double d;
+                ok = parse_number(value, d) && d > 0;
+                if (ok) x = d;
+                else range = "a number above 0";
+            };
+            auto integer = [&](int& x, int min = INT_MIN) { // at least min
+                double d;
+                ok = parse_number(value, d) && d == static_cast<int>(d) && d >= min;
+                if (ok) x = static_cast<int>(d);
+                else if (min > INT_MIN) range = "a whole number of at least " + to_string(min);
+            };
+            auto flag = [&](bool& x) {
+                if (value == "1" || value == "true" || value == "on") x = true;
+                else if (value == "0" || value == "false" || value == "off") x = false;
+                else ok = false;
+            };
+            auto vec = [&](vec3& x) { ok = parse_vec3(value, x); };
+            auto part = [&](int& index, int& count) { // index/count
+                char rest;
+                int i, n;
+                ok = sscanf(value.c_str(), "%d/%d%c", &i, &n, &rest) == 2 && n >= 1 && i >= 0 && i < n;
+                if (ok) { index = i; count = n; }
+            };
+
+            if (key == "width") integer(cam.image_width, 1);
+            else if (key == "aspect_ratio") positive(cam.aspect_ratio);
+            else if (key == "spp") integer(cam.samples_per_pixel, 1);
+            else if (key == "max_depth") integer(cam.max_depth, 1);
+            else if (key == "roulette_depth") integer(cam.roulette_depth);
+            else if (key == "vfov") number(cam.vfov);
+            else if (key == "lookfrom") vec(cam.lookfrom);
+            else if (key == "lookat") vec(cam.lookat);
+            else if (key == "vup") vec(cam.vup);
+            else if (key == "defocus_angle") number(cam.defocus_angle);
+            else if (key == "focus_dist") number(cam.focus_dist);
+            else if (key == "background") vec(cam.background);
+            else if (key == "sky") flag(cam.sky);
+            else if (key == "threads") integer(cam.num_threads, 0);
+            else if (key == "tile_size") integer(cam.tile_size, 1);
+            else if (key == "seed") { double d; ok = parse_number(value, d) && d >= 0; if (ok) cam.seed = static_cast<uint64_t>(d); }
+            else if (key == "sampling") {
+                if (value == "independent") cam.sampling = sample_pattern::independent;
+                else if (value == "stratified") cam.sampling = sample_pattern::stratified;
+                else if (value == "sobol") cam.sampling = sample_pattern::sobol;
+                else ok = false;
+            }
+            else if (key == "adaptive") flag(cam.adaptive);
+            else if (key == "min_samples") integer(cam.min_samples, 1);
+            else if (key == "adaptive_tolerance") positive(cam.adaptive_tolerance);
+            else if (key == "checkpoint") cam.checkpoint_path = value;
+            else if (key == "checkpoint_interval") number(cam.checkpoint_interval);
+            else if (key == "resume") flag(cam.resume);
+            else if (key == "part") part(cam.part_index, cam.part_count);
+            else if (key == "sample_part") part(cam.sample_part, cam.sample_part_count);
+            else if (key == "partial") cam.partial_path = value;
+            else if (key == "crop" || key == "crop_region") { // x0,y0,x1,y1 in pixels, or in fractions of the image size
+                crop_window c;
+                char rest;
+                ok = sscanf(value.c_str(), "%lf,%lf,%lf,%lf%c", &c.x0, &c.y0, &c.x1, &c.y1, &rest) == 4 && !c.empty();
+                c.normalized = (key == "crop_region");
+                if (ok) cam.crop = c;
+            }
+            else if (key == "crop_full") flag(cam.crop_full_size);
+            else if (key == "progressive") flag(cam.progressive);
+            else if (key == "progressive_interval") number(cam.progressive_interval);
+            else if (key == "wavefront") flag(cam.wavefront);
+            else if (key == "wavefront_batch") integer(cam.wavefront_batch, 1);
+            else if (key == "ray_packets") flag(cam.ray_packets);
+            else if (key == "denoise") flag(cam.denoise);
+            else if (key == "albedo") cam.albedo_path = value;
+            else if (key == "normal") cam.normal_path = value;
+            else if (key == "output") cam.output_path = value;
+            else if (key == "sample_map") cam.sample_map_path = value;
+            else if (key == "light_aovs") cam.light_aov_path = value;
+            else if (key == "stats") cam.stats_path = value;
+            else if (key == "preview") flag(s.preview);
+            else {
+                clog << "ERROR: Unknown setting '" << key << "'.\n";
+                return false;
+            }
+            if (!ok) clog << "ERROR: Invalid value '" << value << "' for setting '" << key << "'"
+                          << (range.empty() ? "" : " (needs " + range + ")") << ".\n";
+            return ok;
+        }
+
+    private:
+        struct file_entry {
+            hittable_list world;
+            hittable_list lights;
+            vector<pair<string, string>> options; // camera settings, in file order
+            double bvh_seconds = 0;
+            animation anim; // animated objects are only in here, not in world
+        };
+
+        struct named_object { // an object with name=, animated if keyframes refer to it
+            shared_ptr<hittable> object; // without its transform
+            double angle = 0;
+            vec3 offset;
+            bool sampleable = false;
+        };
+
+        struct statement { // one line of a scene file, split into words and key=value parameters
+            vector<string> words;
+            map<string, string> params;
+        };
+
+        map<string, file_entry> files;
+        map<string, scene> builtins;
+        map<string, shared_ptr<texture>> image_textures; // by file name
+        map<string, shared_ptr<mesh>> meshes;            // by file name
+
+        // Parsing context of the current file
+        string current_path;
+        int current_line = 0;
+        double bvh_seconds = 0;
+        map<string, shared_ptr<texture>> textures;
+        map<string, shared_ptr<material>> materials;
+
+        bool error(const string& message) const {
+            clog << "ERROR: " << current_path << ":" << current_line << ": " << message << "\n";
+            return false;
+        }
+
+        bool parse(istream& in, const string& path, file_entry& entry) {
+            current_path = path;
+            current_line = 0;
+            bvh_seconds = 0;
+            textures.clear();
+            materials.clear();
+
+            hittable_list objects;
+            map<string, named_object> named;
+            map<string, int> keyed; // names of animated objects, with the line of their first keyframe
+            int frames = 0, last_key = -1;
+            bool use_bvh = true;
+            string line;
+            while (getline(in, line)) {
+                current_line++;
+                auto comment = line.find('#');
+                if (comment != string::npos) line.erase(comment);
+
+                statement st;
+                istringstream tokens(line);
+                string token;
+                while (tokens >> token) {
+                    auto eq = token.find('=');
+                    if (eq == string::npos) st.words.push_back(token);
+                    else st.params[token.substr(0, eq)] = token.substr(eq + 1);
+                }
+                if (st.words.empty()) {
+                    if (!st.params.empty()) return error("a line has to start with what it defines");
+                    continue;
+                }
+
+                const string& kind = st.words[0];
+                if (kind == "camera") {
+                    if (st.words.size() > 1) return error("camera takes key=value settings only");
+                    scene check; // validate now, so that errors point at the line
+                    for (const auto& p : st.params) {
+                        if (!set_option(check, p.first, p.second)) return error("in camera settings");
+                        entry.options.push_back(p);
+                    }
+                } else if (kind == "texture") {
+                    if (!parse_texture(st)) return false;
+                } else if (kind == "material") {
+                    if (!parse_material(st)) return false;
+                } else if (kind == "bvh") {
+                    if (st.words.size() != 2 || (st.words[1] != "on" && st.words[1] != "off")) return error("use 'bvh on' or 'bvh off'");
+                    use_bvh = (st.words[1] == "on");
+                } else if (kind == "frames") {
+                    double count;
+                    if (st.words.size() != 2 || !parse_number(st.words[1], count) || count < 1 || count != static_cast<int>(count))
+                        return error("use 'frames <count>'");
+                    frames = static_cast<int>(count);
+                    entry.anim.frame_count = frames;
+                    if (last_key >= frames) return error("there is a keyframe at frame " + to_string(last_key));
+                } else if (kind == "keyframe") {
+                    if (!parse_keyframe(st, frames, entry.anim, last_key, keyed)) return false;
+                } else {
+                    // A shape, or a medium: medium <its parameters> <shape> <shape parameters>
+                    statement medium_st, shape_st;
+                    bool is_medium = (kind == "medium");
+                    if (is_medium) {
+                        split_medium(line, medium_st, shape_st);
+                        if (shape_st.words.empty()) return error("medium needs a boundary shape, e.g. 'medium density=0.01 color=1,1,1 sphere ...'");
+                    }
+                    const statement& shape = is_medium ? shape_st : st;
+                    shared_ptr<hittable> object;
+                    bool sampleable;
+                    if (!parse_shape(shape, object, sampleable)) return false;
+
+                    string name = shape.params.count("name") ? shape.params.at("name") : "";
+                    if (is_medium && medium_st.params.count("name")) name = medium_st.params.at("name");
+                    if (name.empty() && !transform(shape, object, sampleable)) return false;
+                    if (is_medium) {
+                        object = make_medium(medium_st, object);
+                        if (!object) return false;
+                        sampleable = false;
+                    }
+                    if (name.empty()) {
+                        objects.add(object);
+                        if (sampleable) entry.lights.add(object);
+                        continue;
+                    }
+
+                    // Its transform is applied at the end of the file, once it is known whether keyframes animate it
+                    if (named.count(name)) return error("there already is an object named '" + name + "'");
+                    named_object& n = named[name];
+                    if (shape.params.count("rotate_y") && !number_param(shape, "rotate_y", n.angle)) return false;
+                    if (shape.params.count("translate") && !vec3_param(shape, "translate", n.offset)) return false;
+                    n.object = object;
+                    n.sampleable = sampleable;
+                }
+            }
+
+            for (const auto& k : keyed) {
+                if (named.count(k.first)) continue;
+                current_line = k.second;
+                return error("no object is named '" + k.first + "'");
+            }
+            for (auto& n : named) {
+                named_object& o = n.second;
+                if (keyed.count(n.first)) {
+                    entry.anim.add_object(n.first, o.object, o.angle, o.offset);
+                    continue;
+                }
+                // Not animated after all, it is static like any other object
+                if (o.angle != 0) { o.object = make_shared<rotate_y>(o.object, o.angle); o.sampleable = false; }
+                if (o.offset.length_squared() > 0) { o.object = make_shared<translate>(o.object, o.offset); o.sampleable = false; }
+                objects.add(o.object);
+                if (o.sampleable) entry.lights.add(o.object);
+            }
+            if (last_key >= 0 && frames == 0) entry.anim.frame_count = last_key + 1; // the sequence ends at the last keyframe
+
+            if (use_bvh && objects.objects.size() > 1)
+                entry.world.add(build_bvh(objects));
+            else
+                entry.world = objects;
+            entry.bvh_seconds = bvh_seconds;
+            return true;
+        }
+
+        static void split_medium(const string& line, statement& medium_st, statement& shape_st) {
+            // The medium's own parameters come before the shape word, the shape's after it
+            istringstream tokens(line);
+            string token;
+            statement* target = &medium_st;
+            while (tokens >> token) {
+                auto eq = token.find('=');
+                if (eq == string::npos && !medium_st.words.empty()) target = &shape_st; // the first word is 'medium'
+                if (eq == string::npos) target->words.push_back(token);
+                else target->params[token.substr(0, eq)] = token.substr(eq + 1);
+            }
+        }
+
+        shared_ptr<hittable> build_bvh(const hittable_list& list) {
+            // Like scene::build_bvh, the time goes into bvh_seconds of the file
+            auto start = std::chrono::steady_clock::now();
+            auto node = make_bvh(list);
+            bvh_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return node;
+        }
+
+        bool parse_texture(const statement& st) {
+            if (st.words.size() != 3) return error("use 'texture <name> <type> key=value ...'");
+            const string& name = st.words[1];
+            const string& type = st.words[2];
+            shared_ptr<texture> tex;
+            if (type == "solid") {
+                color c;
+                if (!vec3_param(st, "color", c)) return false;
+                tex = make_shared<solid_color>(c);
+            } else if (type == "checker") {
+                double scale;
+                color even, odd;
+                if (!number_param(st, "scale", scale) || !vec3_param(st, "even", even) || !vec3_param(st, "odd", odd)) return false;
+                tex = make_shared<checker_texture>(scale, even, odd);
+            } else if (type == "image") {
+                auto file = st.params.find("file");
+                if (file == st.params.end()) return error("image texture needs file=...");
+                auto& cached = image_textures[file->second];
+                if (!cached) cached = make_shared<image_texture>(file->second.c_str());
+                tex = cached;
+            } else if (type == "noise") {
+                tex = make_shared<noise_texture>();
+            } else {
+                return error("unknown texture type '" + type + "'");
+            }
+            textures[name] = tex;
+            return true;
+        }
+
+        bool parse_material(const statement& st) {
+            if (st.words.size() != 3) return error("use 'material <name> <type> key=value ...'");
+            const string& name = st.words[1];
+            const string& type = st.words[2];
+            shared_ptr<material> mat;
+            if (type == "lambertian" || type == "light" || type == "isotropic") {
+                shared_ptr<texture> tex;
+                if (!texture_param(st, tex)) return false;
+                if (type == "lambertian") mat = make_shared<lambertian>(tex);
+                else if (type == "light") mat = make_shared<diffuse_light>(tex);
+                else mat = make_shared<isotropic>(tex);
+            } else if (type == "metal") {
+                color albedo;
+                double fuzz = 0;
+                if (!vec3_param(st, "color", albedo)) return false;
+                if (st.params.count("fuzz") && !number_param(st, "fuzz", fuzz)) return false;
+                mat = make_shared<metal>(albedo, fuzz);
+            } else if (type == "dielectric") {
+                double ior;
+                if (!number_param(st, "ior", ior)) return false;
+                mat = make_shared<dielectric>(ior);
+            } else {
+                return error("unknown material type '" + type + "'");
+            }
+            mat->name = name;
+            materials[name] = mat;
+            return true;
+        }
+
+        bool parse_keyframe(const statement& st, int frames, animation& anim, int& last_key, map<string, int>& keyed) {
+            // keyed: the names of keyframed objects, they are checked against the file's objects at its end
+            double frame;
+            if (st.words.size() != 3 || !parse_number(st.words[1], frame) || frame < 0 || frame != static_cast<int>(frame))
+                return error("use 'keyframe <frame> camera|<object name> key=value ...'");
+            if (frames > 0 && frame >= frames) return error("frame " + st.words[1] + " is past the last frame");
+            if (st.params.empty()) return error("a keyframe needs key=value settings");
+            last_key = max(last_key, static_cast<int>(frame));
+
+            const string& target = st.words[2];
+            for (const auto& p : st.params) {
+                const string& key = p.first;
+                bool vector_key, allowed;
+                if (target == "camera") {
+                    vector_key = (key == "lookfrom" || key == "lookat" || key == "vup" || key == "background");
+                    allowed = vector_key || key == "vfov" || key == "defocus_angle" || key == "focus_dist";
+                    if (!allowed) return error("the camera setting '" + key + "' can not be keyframed");
+                } else {
+                    vector_key = (key == "translate");
+                    allowed = vector_key || key == "rotate_y";
+                    if (!allowed) return error("objects are keyframed with rotate_y & translate only");
+                }
+
+                vector<double> value;
+                if (vector_key) {
+                    vec3 v;
+                    if (!vec3_param(st, key, v)) return false;
+                    value = {v.x(), v.y(), v.z()};
+                } else {
+                    double x;
+                    if (!number_param(st, key, x)) return false;
+                    value = {x};
+                }
+                if (target == "camera") anim.add_camera_key(frame, key, value);
+                else anim.add_object_key(frame, target, key, value);
+            }
+            if (target != "camera") keyed.emplace(target, current_line);
+            return true;
+        }
+
+        shared_ptr<hittable> make_medium(const statement& medium_st, shared_ptr<hittable> boundary) {
+            // The medium filling boundary, null after an error
+            double density;
+            shared_ptr<texture> albedo;
+            if (!number_param(medium_st, "density", density) || !texture_param(medium_st, albedo)) return nullptr;
+            return make_shared<constant_medium>(boundary, density, albedo);
+        }
+
+        bool parse_shape(const statement& st, shared_ptr<hittable>& object, bool& sampleable) {
+            // object: the shape without its transform, sampleable: a light that the camera can sample directly
+            const string& kind = st.words[0];
+            if (st.words.size() != 1) return error("unexpected word '" + st.words[1] + "'");
+            sampleable = false;
+
+            shared_ptr<material> mat;
+            auto m = st.params.find("material");
+            if (m == st.params.end()) return error(kind + " needs material=...");
+            auto found = materials.find(m->second);
+            if (found == materials.end()) return error("unknown material '" + m->second + "'");
+            mat = found->second;
+
+            if (kind == "sphere") {
+                point3 center, center2;
+                double radius;
+                if (!vec3_param(st, "center", center) || !number_param(st, "radius", radius)) return false;
+                if (st.params.count("center2")) {
+                    if (!vec3_param(st, "center2", center2)) return false;
+                    object = make_shared<sphere>(center, center2, radius, mat);
+                } else {
+                    object = make_shared<sphere>(center, radius, mat);
+                    sampleable = true;
+                }
+            } else if (kind == "quad" || kind == "triangle") {
+                point3 q;
+                vec3 u, v;
+                if (!vec3_param(st, "q", q) || !vec3_param(st, "u", u) || !vec3_param(st, "v", v)) return false;
+                if (kind == "quad") object = make_shared<quad>(q, u, v, mat);
+                else object = make_shared<triangle>(q, u, v, mat);
+                sampleable = true;
+            } else if (kind == "cuboid") {
+                point3 center;
+                vec3 size;
+                if (!vec3_param(st, "center", center) || !vec3_param(st, "size", size)) return false;
+                if (st.params.count("angles")) {
+                    vec3 angles;
+                    if (!vec3_param(st, "angles", angles)) return false;
+                    auto rotation = st.params.count("rotation") ? st.params.at("rotation") : string("euler");
+                    object = make_shared<cuboid>(center, size.x(), size.y(), size.z(), mat, degrees_to_radians(angles.x()),
+                                                 degrees_to_radians(angles.y()), degrees_to_radians(angles.z()), rotation);
+                } else {
+                    object = make_shared<cuboid>(center, size.x(), size.y(), size.z(), mat);
+                }
+            } else if (kind == "box") {
+                point3 a, b;
+                if (!vec3_param(st, "min", a) || !vec3_param(st, "max", b)) return false;
+                object = box(a, b, mat);
+            } else if (kind == "mesh") {
+                auto file = st.params.find("file");
+                if (file == st.params.end()) return error("mesh needs file=...");
+                double scale = 1;
+                if (st.params.count("scale") && !number_param(st, "scale", scale)) return false;
+                auto& cached = meshes[file->second];
+                if (!cached) {
+                    auto loaded = make_shared<mesh>();
+                    if (!mesh_loader().load(file->second, *loaded) || loaded->vindices.empty()) {
+                        meshes.erase(file->second);
+                        return error("could not load mesh '" + file->second + "'");
+                    }
+                    cached = loaded;
+                }
+                hittable_list triangles;
+                cached->create_object(triangles, mat, scale);
+                object = build_bvh(triangles);
+            } else {
+                return error("unknown statement '" + kind + "'");
+            }
+            sampleable = sampleable && dynamic_pointer_cast<diffuse_light>(mat) != nullptr;
+            return true;
+        }
+
+        bool transform(const statement& st, shared_ptr<hittable>& object, bool& sampleable) {
+            // Applies the rotate_y & translate parameters of st to object
+            if (st.params.count("rotate_y")) {
+                double angle;
+                if (!number_param(st, "rotate_y", angle)) return false;
+                object = make_shared<rotate_y>(object, angle);
+                sampleable = false;
+            }
+            if (st.params.count("translate")) {
+                vec3 offset;
+                if (!vec3_param(st, "translate", offset)) return false;
+                object = make_shared<translate>(object, offset);
+                sampleable = false;
+            }
+            return true;
+        }
+
+        bool texture_param(const statement& st, shared_ptr<texture>& tex) {
+            // texture=<name> or color=r,g,b
+            auto t = st.params.find("texture");
+            if (t != st.params.end()) {
+                auto found = textures.find(t->second);
+                if (found == textures.end()) return error("unknown texture '" + t->second + "'");
+                tex = found->second;
+                return true;
+            }
+            color c;
+            if (!vec3_param(st, "color", c)) return false;
+            tex = make_shared<solid_color>(c);
+            return true;
+        }
+
+        bool number_param(const statement& st, const string& key, double& x) {
+            auto p = st.params.find(key);
+            if (p == st.params.end()) return error(st.words[0] + " needs " + key + "=...");
+            if (!parse_number(p->second, x)) return error("'" + p->second + "' is not a number (" + key + ")");
+            return true;
+        }
+
+        bool vec3_param(const statement& st, const string& key, vec3& v) {
+            auto p = st.params.find(key);
+            if (p == st.params.end()) return error(st.words[0] + " needs " + key + "=x,y,z");
+            if (!parse_vec3(p->second, v)) return error("'" + p->second + "' is not a vector x,y,z (" + key + ")");
+            return true;
+        }
+
+        static bool parse_number(const string& text, double& x) {
+            // Plain numbers, and fractions like 16/9 (aspect ratios)
+            auto slash = text.find('/');
+            if (slash != string::npos) {
+                double a, b;
+                if (!parse_number(text.substr(0, slash), a) || !parse_number(text.substr(slash + 1), b) || b == 0) return false;
+                x = a / b;
+                return true;
+            }
+            if (text.empty()) return false;
+            char* end;
+            x = strtod(text.c_str(), &end);
+            return *end == '\0';
+        }
+
+        static bool parse_vec3(const string& text, vec3& v) {
+            double c[3];
+            size_t start = 0;
+            for (int i = 0; i < 3; i++) {
+                auto comma = text.find(',', start);
+                if ((i < 2) != (comma != string::npos)) return false;
+                if (!parse_number(text.substr(start, comma == string::npos ? string::npos : comma - start), c[i])) return false;
+                start = comma + 1;
+            }
+            v = vec3(c[0], c[1], c[2]);
+            return true;
+        }
+};
+
+#endif
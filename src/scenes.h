@@ -0,0 +1,663 @@
+// Example scenes --> shared by main and bench
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "general.h"
+#include "color.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "sphere.h"
+#include "cuboid.h"
+#include "camera.h"
+#include "material.h"
+#include "bvh.h"
+#include "wide_bvh.h"
+#include "texture.h"
+#include "quad.h"
+#include "mesh.h"
+#include "constant_medium.h"
+#include "mesh_loader.h"
+#include "animation.h"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct scene {
+    hittable_list world;
+    hittable_list lights;  // Emitters of world that the camera samples directly, empty turns light sampling off
+    camera cam;            // With the scene's own view & quality settings
+    bool preview = false;  // Shown with camera::display by default, a full render takes too long
+    bool complete = true;  // false if an input file (e.g. a mesh) could not be loaded
+    double bvh_seconds = 0; // Time spent in build_bvh
+    shared_ptr<animation> anim; // Keyframes of a frame sequence, null for a still image (see scene_loader::set_frame)
+
+    // Functions
+    shared_ptr<hittable> build_bvh(const hittable_list& list) {
+        // A BVH over list (see make_bvh), its construction time is added to bvh_seconds
+        if (list.objects.empty()) return make_shared<hittable_list>(); // (e.g. a mesh that failed to load)
+        auto start = std::chrono::steady_clock::now();
+        auto node = make_bvh(list);
+        bvh_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return node;
+    }
+
+    bool render() {
+        // A part of a distributed render (partial=, part=, sample_part=) is always path traced: display() has no
+        // --> samples to split between workers and merge again
+        bool distributed = !cam.partial_path.empty() || cam.part_count > 1 || cam.sample_part_count > 1;
+        if (preview && !distributed) return cam.display(world);
+        if (lights.objects.empty()) return cam.render(world);
+        return cam.render(world, lights);
+    }
+};
+
+// At its core, a ray tracer sends rays through pixels and computes the color seen in the direction of those rays.
+inline scene main_schene() {
+    scene s;
+
+    // WORLD
+
+    auto material_ground = make_shared<lambertian>(color(0.2, 0.2, 0.2));
+    auto material_center = make_shared<lambertian>(color(0.0, 0.0, 0.6));
+    auto material_left   = make_shared<dielectric>(1.5);
+    auto material_right  = make_shared<metal>(color(0.8, 0.6, 0.2), 0.0);
+
+    // Our world
+    auto checker = make_shared<checker_texture>(0.32, color(.2, .3, .1), color(.9, .9, .9));
+    s.world.add(make_shared<sphere>(point3(0,-1000,0), 1000, make_shared<lambertian>(checker)));
+    //s.world.add(make_shared<sphere>(point3( 0.0, -100.5, -1.0), 100.0, material_ground));
+
+    // s.world.add(make_shared<sphere>(point3( 0.0,    3.0, -1.0),   0.5, material_center));
+    s.world.add(make_shared<cuboid>(point3(0.0, 3.5, -1.0), 0.8, 0.8, 0.8, material_center, 
+        pi/4, 2*pi/3, pi/6, "euler"));
+    // ===============================================================================
+    auto material_metal_cuboid  = make_shared<metal>(color(0.95, 0.95, 0.95), 0.05);
+    // s.world.add(make_shared<cuboid>(point3(-1.0, 0.0, -1.0), 0.8, 0.8, 0.8, material_metal_cuboid));
+    s.world.add(make_shared<cuboid>(point3(-3.0, 3.0, -1.0), 2.5, 2.5, 2.5, material_metal_cuboid, 
+        0, pi/3, pi/6, "euler"));
+    // ===============================================================================
+    // s.world.add(make_shared<sphere>(point3(-1.0,    0.0, -1.0),   0.5, material_left));
+    // s.world.add(make_shared<sphere>(point3(-1.0,    0.0, -1.0),  -0.4, material_left)); // use inverted radius to invert their normals
+    // --> thus making a hollow glass sphere, if you combine the above 2 surfaces
+    // ===============================================================================
+    s.world.add(make_shared<sphere>(point3( 1.0,    2.5, -1.0),   0.5, material_right));
+
+    // make_shared<T> constructs an object of type T and wraps it in a shared_ptr using args as the parameter list for the constructor of T
+    // s.world = hittable_list(s.build_bvh(s.world));
+
+    // CAMERA
+
+    s.cam.aspect_ratio = 16.0 / 9.0;
+    s.cam.image_width  = 400; // 1200
+    s.cam.samples_per_pixel = 100;
+    // TODO: make it possible to turn off annealing, since it is computationally very expensive 
+    // --> computes samples_per_pixel ray colors for each pixel! Is there a way to reuse the already calculated values?
+    s.cam.max_depth = 50;
+    s.cam.background        = color(0.70, 0.80, 1.00);
+
+    s.cam.vfov     = 50;
+    s.cam.lookfrom = point3(0,3.5,4);
+    s.cam.lookat   = point3(-1,3,-1);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 2.0; 
+    s.cam.focus_dist    = 3.4;
+
+
+    return s;
+}
+
+inline scene random_spheres() {
+    scene s;
+
+    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    s.world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                shared_ptr<material> sphere_material;
+
+                if (choose_mat < 0.8) {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    sphere_material = make_shared<lambertian>(albedo);
+                    // s.world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                    auto center2 = center + vec3(0, random_double(0,.5), 0); // falling spheres
+                    s.world.add(make_shared<sphere>(center, center2, 0.2, sphere_material));
+                } else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = make_shared<metal>(albedo, fuzz);
+                    s.world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                } else {
+                    // glass
+                    sphere_material = make_shared<dielectric>(1.5);
+                    s.world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = make_shared<dielectric>(1.5);
+    s.world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+
+    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
+    s.world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+
+    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
+    s.world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+
+    s.world = hittable_list(s.build_bvh(s.world));
+
+
+    s.cam.aspect_ratio      = 16.0 / 9.0;
+    //s.cam.image_width       = 1200;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0.70, 0.80, 1.00);
+
+    s.cam.vfov     = 20;
+    s.cam.lookfrom = point3(13,2,3);
+    s.cam.lookat   = point3(0,0,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0.6;
+    s.cam.focus_dist    = 10.0;
+
+
+    s.preview = true; // main shows it with display(), a full render takes long
+
+    return s;
+}
+
+inline scene two_spheres() {
+    scene s;
+
+    auto checker = make_shared<checker_texture>(0.8, color(.2, .3, .1), color(.9, .9, .9));
+
+    s.world.add(make_shared<sphere>(point3(0,-10, 0), 10, make_shared<lambertian>(checker)));
+    s.world.add(make_shared<sphere>(point3(0, 10, 0), 10, make_shared<lambertian>(checker)));
+
+
+    s.cam.aspect_ratio      = 16.0 / 9.0;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0.70, 0.80, 1.00);
+
+    s.cam.vfov     = 20;
+    s.cam.lookfrom = point3(13,2,3);
+    s.cam.lookat   = point3(0,0,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    return s;
+}
+
+inline scene earth() {
+    scene s;
+    auto earth_texture = make_shared<image_texture>("earthmap.jpg");
+    auto earth_surface = make_shared<lambertian>(earth_texture);
+    auto globe = make_shared<sphere>(point3(0,0,0), 2, earth_surface);
+    s.world.add(globe);
+
+
+    s.cam.aspect_ratio      = 16.0 / 9.0;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0.70, 0.80, 1.00);
+
+    s.cam.vfov     = 20;
+    s.cam.lookfrom = point3(0,0,12);
+    s.cam.lookat   = point3(0,0,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    return s;
+}
+
+inline scene two_perlin_spheres() {
+    scene s;
+
+    auto pertext = make_shared<noise_texture>();
+    s.world.add(make_shared<sphere>(point3(0,-1000,0), 1000, make_shared<lambertian>(pertext)));
+    s.world.add(make_shared<sphere>(point3(0,2,0), 2, make_shared<lambertian>(pertext)));
+
+
+    s.cam.aspect_ratio      = 16.0 / 9.0;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0.70, 0.80, 1.00);
+
+    s.cam.vfov     = 20;
+    s.cam.lookfrom = point3(13,2,3);
+    s.cam.lookat   = point3(0,0,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    return s;
+}
+
+inline scene quads() {
+    scene s;
+
+    // Materials
+    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
+    auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
+    auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
+    auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
+    auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
+
+    // Quads
+    s.world.add(make_shared<quad>(point3(-3,-2, 5), vec3(0, 0,-4), vec3(0, 4, 0), left_red));
+    s.world.add(make_shared<quad>(point3(-2,-2, 0), vec3(4, 0, 0), vec3(0, 4, 0), back_green));
+    s.world.add(make_shared<quad>(point3( 3,-2, 1), vec3(0, 0, 4), vec3(0, 4, 0), right_blue));
+    s.world.add(make_shared<quad>(point3(-2, 3, 1), vec3(4, 0, 0), vec3(0, 0, 4), upper_orange));
+    s.world.add(make_shared<quad>(point3(-2,-3, 5), vec3(4, 0, 0), vec3(0, 0,-4), lower_teal));
+
+
+    s.cam.aspect_ratio      = 1.0;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0.70, 0.80, 1.00);
+
+    s.cam.vfov     = 80;
+    s.cam.lookfrom = point3(0,0,9);
+    s.cam.lookat   = point3(0,0,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    return s;
+}
+
+inline scene triangles() {
+    scene s;
+
+    // Materials
+    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
+    auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
+    auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
+    auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
+    auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
+
+    // Quads
+    s.world.add(make_shared<triangle>(point3(-3,-2, 5), vec3(0, 0,-4), vec3(0, 4, 0), left_red));
+    s.world.add(make_shared<triangle>(point3(-2,-2, 0), vec3(4, 0, 0), vec3(0, 4, 0), back_green));
+    s.world.add(make_shared<triangle>(point3( 3,-2, 1), vec3(0, 0, 4), vec3(0, 4, 0), right_blue));
+    s.world.add(make_shared<triangle>(point3(-2, 3, 1), vec3(4, 0, 0), vec3(0, 0, 4), upper_orange));
+    s.world.add(make_shared<triangle>(point3(-2,-3, 5), vec3(4, 0, 0), vec3(0, 0,-4), lower_teal));
+
+
+    s.cam.aspect_ratio      = 1.0;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0.70, 0.80, 1.00);
+
+    s.cam.vfov     = 80;
+    s.cam.lookfrom = point3(0,0,9);
+    s.cam.lookat   = point3(0,0,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    return s;
+}
+
+inline scene simple_light() {
+    scene s;
+
+    auto pertext = make_shared<noise_texture>();
+    s.world.add(make_shared<sphere>(point3(0,-1000,0), 1000, make_shared<lambertian>(pertext)));
+    s.world.add(make_shared<sphere>(point3(0,2,0), 2, make_shared<lambertian>(pertext)));
+
+    // auto sphere_color = color(0.2, 0.2, 0.2);
+    // s.world.add(make_shared<sphere>(point3(0,-1000,0), 1000, make_shared<lambertian>(sphere_color)));
+    // auto marble_texture = make_shared<image_texture>("marble.jpg");
+    // auto marble_surface = make_shared<lambertian>(marble_texture);
+    // s.world.add(make_shared<sphere>(point3(0,2,0), 2, marble_surface));
+
+    auto difflight = make_shared<diffuse_light>(color(4,4,4));
+    auto fill_light = make_shared<diffuse_light>(color(4,4,4)); // its own material, so it gets its own light buffer
+    s.lights.add(make_shared<sphere>(point3(0,7,0), 2, difflight)); // the emitters again, the camera samples them directly
+    s.lights.add(make_shared<quad>(point3(3,1,-2), vec3(2,0,0), vec3(0,2,0), fill_light));
+    for (const auto& light : s.lights.objects) s.world.add(light);
+
+
+    s.cam.aspect_ratio      = 16.0 / 9.0;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0,0,0);
+
+    s.cam.vfov     = 20;
+    s.cam.lookfrom = point3(26,3,6);
+    s.cam.lookat   = point3(0,2,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    return s;
+}
+
+inline scene cornell_box() {
+    scene s;
+    // this will be very noisy, since the light source is very small
+
+    auto red   = make_shared<lambertian>(color(.65, .05, .05));
+    auto white = make_shared<lambertian>(color(.73, .73, .73));
+    auto green = make_shared<lambertian>(color(.12, .45, .15));
+    auto light = make_shared<diffuse_light>(color(15, 15, 15));
+
+    s.world.add(make_shared<quad>(point3(555,0,0), vec3(0,555,0), vec3(0,0,555), green));
+    s.world.add(make_shared<quad>(point3(0,0,0), vec3(0,555,0), vec3(0,0,555), red));
+    auto ceiling_light = make_shared<quad>(point3(343, 554, 332), vec3(-130,0,0), vec3(0,0,-105), light);
+    s.world.add(ceiling_light);
+    s.lights.add(ceiling_light); // sampled directly by the camera
+    s.world.add(make_shared<quad>(point3(0,0,0), vec3(555,0,0), vec3(0,0,555), white));
+    s.world.add(make_shared<quad>(point3(555,555,555), vec3(-555,0,0), vec3(0,0,-555), white));
+    s.world.add(make_shared<quad>(point3(0,0,555), vec3(555,0,0), vec3(0,555,0), white));
+
+    // s.world.add(box(point3(130, 0, 65), point3(295, 165, 230), white));
+    // s.world.add(box(point3(265, 0, 295), point3(430, 330, 460), white));
+    shared_ptr<hittable> box1 = box(point3(0,0,0), point3(165,330,165), white);
+    box1 = make_shared<rotate_y>(box1, 15);
+    box1 = make_shared<translate>(box1, vec3(265,0,295));
+    s.world.add(box1);
+
+    shared_ptr<hittable> box2 = box(point3(0,0,0), point3(165,165,165), white);
+    box2 = make_shared<rotate_y>(box2, -18);
+    box2 = make_shared<translate>(box2, vec3(130,0,65));
+    s.world.add(box2);
+
+
+    s.cam.aspect_ratio      = 1.0;
+    s.cam.image_width       = 600;
+    s.cam.samples_per_pixel = 200;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0,0,0);
+
+    s.cam.vfov     = 40;
+    s.cam.lookfrom = point3(278, 278, -800);
+    s.cam.lookat   = point3(278, 278, 0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    return s;
+}
+
+inline scene cornell_smoke() {
+    scene s;
+
+    auto red   = make_shared<lambertian>(color(.65, .05, .05));
+    auto white = make_shared<lambertian>(color(.73, .73, .73));
+    auto green = make_shared<lambertian>(color(.12, .45, .15));
+    auto light = make_shared<diffuse_light>(color(7, 7, 7));
+
+    s.world.add(make_shared<quad>(point3(555,0,0), vec3(0,555,0), vec3(0,0,555), green));
+    s.world.add(make_shared<quad>(point3(0,0,0), vec3(0,555,0), vec3(0,0,555), red));
+    auto ceiling_light = make_shared<quad>(point3(113,554,127), vec3(330,0,0), vec3(0,0,305), light);
+    s.world.add(ceiling_light);
+    s.lights.add(ceiling_light); // sampled directly by the camera
+    s.world.add(make_shared<quad>(point3(0,555,0), vec3(555,0,0), vec3(0,0,555), white));
+    s.world.add(make_shared<quad>(point3(0,0,0), vec3(555,0,0), vec3(0,0,555), white));
+    s.world.add(make_shared<quad>(point3(0,0,555), vec3(555,0,0), vec3(0,555,0), white));
+
+    shared_ptr<hittable> box1 = box(point3(0,0,0), point3(165,330,165), white);
+    box1 = make_shared<rotate_y>(box1, 15);
+    box1 = make_shared<translate>(box1, vec3(265,0,295));
+
+    shared_ptr<hittable> box2 = box(point3(0,0,0), point3(165,165,165), white);
+    box2 = make_shared<rotate_y>(box2, -18);
+    box2 = make_shared<translate>(box2, vec3(130,0,65));
+
+    s.world.add(make_shared<constant_medium>(box1, 0.01, color(0,0,0)));
+    s.world.add(make_shared<constant_medium>(box2, 0.01, color(1,1,1)));
+
+
+    s.cam.aspect_ratio      = 1.0;
+    s.cam.image_width       = 600;
+    s.cam.samples_per_pixel = 200;
+    s.cam.max_depth         = 50;
+    s.cam.background        = color(0,0,0);
+
+    s.cam.vfov     = 40;
+    s.cam.lookfrom = point3(278, 278, -800);
+    s.cam.lookat   = point3(278, 278, 0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    return s;
+}
+
+inline scene mesh_scene_nefertiti() {
+    scene s;
+
+    auto difflight = make_shared<diffuse_light>(color(4,4,4));
+    auto fill_light = make_shared<diffuse_light>(color(4,4,4)); // its own material, so it gets its own light buffer
+    s.lights.add(make_shared<sphere>(point3(0,5,0), 2, difflight)); // the emitters again, the camera samples them directly
+    s.lights.add(make_shared<quad>(point3(4,0,0), vec3(2,0,0), vec3(0,2,0), fill_light));
+    for (const auto& light : s.lights.objects) s.world.add(light);
+
+    auto pertext = make_shared<noise_texture>();
+    s.world.add(make_shared<sphere>(point3(0,-1000,0), 996, make_shared<lambertian>(pertext)));
+
+    // Materials 
+    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
+    // auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
+    // auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
+    // auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
+    // auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
+
+    // MESH LOGIC
+    mesh_loader loader = mesh_loader();
+    mesh nefertiti_mesh;
+    s.complete = loader.load("./mesh/Nefertiti.obj", nefertiti_mesh);
+    hittable_list nefertiti_obj;
+    nefertiti_mesh.create_object(nefertiti_obj, left_red, 1);
+    s.world.add(s.build_bvh(nefertiti_obj));
+
+
+    s.cam.aspect_ratio      = 1.0;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    // s.cam.background        = color(0.70, 0.80, 1.00);
+    s.cam.background        = color(0.0, 0.0, 0.0);
+
+    s.cam.vfov     = 70;
+    s.cam.lookfrom = point3(-5,0,12);
+    s.cam.lookat   = point3(0,0,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    s.preview = true; // main shows it with display(), a full render takes long
+
+    return s;
+}
+
+inline scene mesh_scene_dragon() {
+    scene s;
+
+    auto difflight = make_shared<diffuse_light>(color(4,4,4));
+    auto fill_light = make_shared<diffuse_light>(color(4,4,4)); // its own material, so it gets its own light buffer
+    s.lights.add(make_shared<sphere>(point3(0,90,0), 20, difflight)); // the emitters again, the camera samples them directly
+    s.lights.add(make_shared<quad>(point3(80,0,0), vec3(40,0,0), vec3(0,40,0), fill_light));
+    for (const auto& light : s.lights.objects) s.world.add(light);
+
+    auto pertext = make_shared<noise_texture>();
+    s.world.add(make_shared<sphere>(point3(0,-1000,0), 940, make_shared<lambertian>(pertext)));
+
+    // Materials 
+    auto left_red     = make_shared<lambertian>(color(1.0, 0.2, 0.2));
+    // auto back_green   = make_shared<lambertian>(color(0.2, 1.0, 0.2));
+    // auto right_blue   = make_shared<lambertian>(color(0.2, 0.2, 1.0));
+    // auto upper_orange = make_shared<lambertian>(color(1.0, 0.5, 0.0));
+    // auto lower_teal   = make_shared<lambertian>(color(0.2, 0.8, 0.8));
+
+    mesh_loader loader = mesh_loader();
+    mesh dragon_mesh;
+    s.complete = loader.load("./mesh/xyzrgb_dragon.obj", dragon_mesh);
+    hittable_list dragon_obj;
+    dragon_mesh.create_object(dragon_obj, left_red, 1);
+    s.world.add(s.build_bvh(dragon_obj));
+
+
+    s.cam.aspect_ratio      = 1.0;
+    s.cam.image_width       = 400;
+    s.cam.samples_per_pixel = 100;
+    s.cam.max_depth         = 50;
+    // s.cam.background        = color(0.70, 0.80, 1.00);
+    s.cam.background        = color(0.0, 0.0, 0.0);
+
+    s.cam.vfov     = 70;
+    s.cam.lookfrom = point3(-100,0,100);
+    s.cam.lookat   = point3(0,0,0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    s.preview = true; // main shows it with display(), a full render takes long
+
+    return s;
+}
+
+inline scene final_scene(int image_width = 800, int samples_per_pixel = 10, int max_depth = 20) {
+    scene s;
+    hittable_list boxes1;
+    auto ground = make_shared<lambertian>(color(0.48, 0.83, 0.53));
+
+    int boxes_per_side = 20;
+    for (int i = 0; i < boxes_per_side; i++) {
+        for (int j = 0; j < boxes_per_side; j++) {
+            auto w = 100.0;
+            auto x0 = -1000.0 + i*w;
+            auto z0 = -1000.0 + j*w;
+            auto y0 = 0.0;
+            auto x1 = x0 + w;
+            auto y1 = random_double(1,101);
+            auto z1 = z0 + w;
+
+            boxes1.add(box(point3(x0,y0,z0), point3(x1,y1,z1), ground));
+        }
+    }
+
+
+    s.world.add(s.build_bvh(boxes1));
+
+    auto light = make_shared<diffuse_light>(color(7, 7, 7));
+    auto ceiling_light = make_shared<quad>(point3(123,554,147), vec3(300,0,0), vec3(0,0,265), light);
+    s.world.add(ceiling_light);
+    s.lights.add(ceiling_light); // sampled directly by the camera
+
+    auto center1 = point3(400, 400, 200);
+    auto center2 = center1 + vec3(30,0,0);
+    auto sphere_material = make_shared<lambertian>(color(0.7, 0.3, 0.1));
+    s.world.add(make_shared<sphere>(center1, center2, 50, sphere_material));
+
+    s.world.add(make_shared<sphere>(point3(260, 150, 45), 50, make_shared<dielectric>(1.5)));
+    s.world.add(make_shared<sphere>(
+        point3(0, 150, 145), 50, make_shared<metal>(color(0.8, 0.8, 0.9), 1.0)
+    ));
+
+    auto boundary = make_shared<sphere>(point3(360,150,145), 70, make_shared<dielectric>(1.5));
+    s.world.add(boundary);
+    s.world.add(make_shared<constant_medium>(boundary, 0.2, color(0.2, 0.4, 0.9)));
+    boundary = make_shared<sphere>(point3(0,0,0), 5000, make_shared<dielectric>(1.5));
+    s.world.add(make_shared<constant_medium>(boundary, .0001, color(1,1,1)));
+
+    auto emat = make_shared<lambertian>(make_shared<image_texture>("earthmap.jpg"));
+    s.world.add(make_shared<sphere>(point3(400,200,400), 100, emat));
+    // auto pertext = make_shared<noise_texture>(0.1);
+    auto pertext = make_shared<noise_texture>();
+    s.world.add(make_shared<sphere>(point3(220,280,300), 80, make_shared<lambertian>(pertext)));
+
+    hittable_list boxes2;
+    auto white = make_shared<lambertian>(color(.73, .73, .73));
+    int ns = 1000;
+    for (int j = 0; j < ns; j++) {
+        boxes2.add(make_shared<sphere>(point3::random(0,165), 10, white));
+    }
+
+    s.world.add(make_shared<translate>(
+        make_shared<rotate_y>(
+            s.build_bvh(boxes2), 15),
+            vec3(-100,270,395)
+        )
+    );
+
+
+    s.cam.aspect_ratio      = 1.0;
+    s.cam.image_width       = image_width;
+    s.cam.samples_per_pixel = samples_per_pixel;
+    s.cam.max_depth         = max_depth;
+    s.cam.background        = color(0,0,0);
+
+    s.cam.vfov     = 40;
+    s.cam.lookfrom = point3(478, 278, -600);
+    s.cam.lookat   = point3(278, 278, 0);
+    s.cam.vup      = vec3(0,1,0);
+
+    s.cam.defocus_angle = 0;
+
+
+    s.preview = true; // main shows it with display(), a full render takes long
+
+    return s;
+}
+
+struct named_scene {
+    string name;
+    function<scene()> build;
+};
+
+inline vector<named_scene> all_scenes() {
+    // Every scene above, by the name main (--scene) and bench know it by
+    return {
+        {"main_schene", main_schene},
+        {"random_spheres", random_spheres},
+        {"two_spheres", two_spheres},
+        {"earth", earth},
+        {"two_perlin_spheres", two_perlin_spheres},
+        {"quads", quads},
+        {"simple_light", simple_light},
+        {"cornell_box", cornell_box},
+        {"cornell_smoke", cornell_smoke},
+        {"triangles", triangles},
+        {"mesh_scene_nefertiti", mesh_scene_nefertiti},
+        {"mesh_scene_dragon", mesh_scene_dragon},
+        {"final_scene", [] { return final_scene(); }},
+    };
+}
+
+#endif
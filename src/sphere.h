@@ -2,6 +2,7 @@
 #define SPHERE_H
 
 #include "hittable.h"
+#include "onb.h"
 
 class sphere : public hittable { // extends hittable 
 
@@ -28,6 +29,7 @@ class sphere : public hittable { // extends hittable
         // Functions
         bool hit(const ray& r, interval ray_t, hit_record& rec) const override { // overrides abstract class method
             // this function checks if the ray hits the sphere, if true, it fills out the hit_record
+            RT_STAT(sphere_tests);
             point3 center = is_moving ? sphere_center(r.time()) : center1; // calculating center loc for given time-point, for moving spheres
             vec3 oc = r.origin() - center;
             auto a = r.direction().length_squared();
@@ -47,20 +49,84 @@ class sphere : public hittable { // extends hittable
                 }
             }
             
-            rec.t = root;
-            rec.p = r.at(root);
-            vec3 outward_normal = (rec.p - center) / radius;
-            rec.set_face_normal(r, outward_normal);
-            get_sphere_uv(outward_normal, rec.u, rec.v);
-            rec.mat = mat;
-
+            fill_record(r, root, center, rec);
+            RT_STAT(sphere_hits);
             return true;
         }
 
+        void hit_packet(ray_packet& packet, uint32_t mask, hit_record* recs) const override {
+            // The quadratic of hit() for simd_double::width rays at a time, the hit record is filled out per ray afterwards
+            if (is_moving) { // every ray sees the sphere at a different time
+                hittable::hit_packet(packet, mask, recs);
+                return;
+            }
+            RT_STAT_ADD(render_stats::sphere_tests, ray_packet::count(mask));
+            for (int k = 0; k < packet.size; k += simd_double::width) {
+                int lanes = (mask >> k) & simd_double::lane_mask;
+                if (lanes == 0) continue;
+                simd_double dx = simd_double::load(packet.dir[0] + k);
+                simd_double dy = simd_double::load(packet.dir[1] + k);
+                simd_double dz = simd_double::load(packet.dir[2] + k);
+                simd_double ocx = simd_double::load(packet.orig[0] + k) - center1.x();
+                simd_double ocy = simd_double::load(packet.orig[1] + k) - center1.y();
+                simd_double ocz = simd_double::load(packet.orig[2] + k) - center1.z();
+                simd_double t_min = simd_double::load(packet.t_min + k);
+                simd_double t_max = simd_double::load(packet.t_max + k);
+
+                auto a = dx*dx + dy*dy + dz*dz;
+                auto half_b = ocx*dx + ocy*dy + ocz*dz;
+                auto c = (ocx*ocx + ocy*ocy + ocz*ocz) - radius*radius;
+                auto discriminant = half_b*half_b - a*c;
+                lanes &= (simd_double(0.0) <= discriminant);
+                if (lanes == 0) continue;
+                auto sqrtd = sqrt(max(discriminant, simd_double(0.0)));
+
+                // Nearest root in (t_min, t_max), the far one if the near one is out of range
+                auto root_near = (simd_double(0.0) - half_b - sqrtd) / a;
+                auto root_far = (simd_double(0.0) - half_b + sqrtd) / a;
+                int near_ok = (t_min < root_near) & (root_near < t_max);
+                int far_ok = (t_min < root_far) & (root_far < t_max);
+                lanes &= near_ok | far_ok;
+                if (lanes == 0) continue;
+
+                alignas(32) double roots[simd_double::width];
+                simd_double::select(near_ok, root_near, root_far).store(roots);
+                for (int l = 0; l < simd_double::width; l++) {
+                    if (!(lanes & (1 << l))) continue;
+                    fill_record(packet.rays[k+l], roots[l], center1, recs[k+l]);
+                    RT_STAT(sphere_hits);
+                    packet.t_max[k+l] = roots[l];
+                    packet.hit[k+l] = true;
+                }
+            }
+        }
+
         aabb bounding_box() const override {
             return bbox;
         }
 
+        double pdf_value(const point3& origin, const vec3& direction) const override {
+            // random() samples the cone of directions in which the sphere is seen, uniformly by solid angle
+            // --> (for moving spheres at time 0)
+            hit_record rec;
+            if (!this->hit(ray(origin, direction), interval(0.001, infinity), rec))
+                return 0;
+
+            auto distance_squared = (center1 - origin).length_squared();
+            if (distance_squared <= radius*radius) return 0; // origin inside the sphere, there is no cone
+            auto cos_theta_max = sqrt(1 - radius*radius/distance_squared);
+            auto solid_angle = 2*pi*(1-cos_theta_max);
+            return 1 / solid_angle;
+        }
+
+        vec3 random(const point3& origin) const override {
+            vec3 direction = center1 - origin;
+            auto distance_squared = direction.length_squared();
+            onb uvw;
+            uvw.build_from_w(direction);
+            return uvw.local(random_to_sphere(radius, distance_squared));
+        }
+
     private:
         point3 center1;
         double radius;
@@ -75,6 +141,28 @@ class sphere : public hittable { // extends hittable
             return center1 + time * center_vec;
         }
 
+        void fill_record(const ray& r, double root, const point3& center, hit_record& rec) const {
+            rec.t = root;
+            rec.p = r.at(root);
+            vec3 outward_normal = (rec.p - center) / radius;
+            rec.set_face_normal(r, outward_normal);
+            get_sphere_uv(outward_normal, rec.u, rec.v);
+            rec.mat = mat.get();
+        }
+
+        static vec3 random_to_sphere(double radius, double distance_squared) {
+            // Direction within the cone around +z that covers a sphere of the given radius & distance
+            auto r1 = random_double();
+            auto r2 = random_double();
+            auto z = 1 + r2*(sqrt(fmax(0.0, 1 - radius*radius/distance_squared)) - 1);
+
+            auto phi = 2*pi*r1;
+            auto x = cos(phi)*sqrt(fmax(0.0, 1 - z*z));
+            auto y = sin(phi)*sqrt(fmax(0.0, 1 - z*z));
+
+            return vec3(x, y, z);
+        }
+
         static void get_sphere_uv(const point3& p, double& u, double& v) { // u & v in hitrecord are computed with this method (object specific)
             // p: a given point on the sphere of radius one, centered at the origin.
             // u: returned value [0,1] of angle around the Y axis from X=-1.
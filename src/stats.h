@@ -0,0 +1,191 @@
+// Render statistics --> per-thread event counters, the detailed ones only compiled in with -DRT_STATS
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class render_stats {
+    // Every thread counts into its own block, so counting is a plain increment without atomics or shared cache lines.
+    // --> When a thread exits (the pools are rebuilt for every render pass), its counts are added to the retired
+    // --> block and its own block is freed, so a long session only keeps the blocks of the threads still running.
+    // --> total() adds up those and the retired counts.
+    // --> The rays (camera, secondary & shadow) are always counted with RT_RAY: one increment per ray, next to a
+    // --> whole BVH traversal, so that every build can report rays per second. Without RT_STATS the RT_STAT macros
+    // --> of the node & primitive counters expand to nothing, so the renderer pays nothing for them.
+
+    public:
+        enum counter {
+            camera_rays, secondary_rays, shadow_rays,
+            bvh_nodes, aabb_tests,
+            // primitive tests & hits, a hits counter always directly follows its tests counter (see hits_of)
+            sphere_tests, sphere_hits,
+            quad_tests, quad_hits,
+            triangle_tests, triangle_hits,
+            cuboid_tests, cuboid_hits,
+            medium_tests, medium_hits,
+            num_counters
+        };
+
+        static constexpr const char* names[num_counters] = {
+            "camera_rays", "secondary_rays", "shadow_rays",
+            "bvh_nodes", "aabb_tests",
+            "sphere_tests", "sphere_hits",
+            "quad_tests", "quad_hits",
+            "triangle_tests", "triangle_hits",
+            "cuboid_tests", "cuboid_hits",
+            "medium_tests", "medium_hits"
+        };
+
+        struct totals {
+            uint64_t value[num_counters] = {};
+            uint64_t operator[](counter c) const { return value[c]; }
+            uint64_t rays() const { return value[camera_rays] + value[secondary_rays] + value[shadow_rays]; }
+        };
+
+        // Functions
+        static counter hits_of(counter tests) { return static_cast<counter>(tests + 1); }
+
+        static void add(counter c, uint64_t n = 1) { local().value[c] += n; }
+
+        static void reset() {
+            // Only call while no render is running
+            lock_guard<mutex> lock(registry_mutex());
+            for (auto& b : blocks())
+                for (auto& v : b->value) v = 0;
+            for (auto& v : retired().value) v = 0;
+        }
+
+        static totals total() {
+            totals t;
+            lock_guard<mutex> lock(registry_mutex());
+            for (auto& b : blocks())
+                for (int c = 0; c < num_counters; c++) t.value[c] += b->value[c];
+            for (int c = 0; c < num_counters; c++) t.value[c] += retired().value[c];
+            return t;
+        }
+
+        static size_t thread_blocks() {
+            // Blocks of the threads that counted something and are still running
+            lock_guard<mutex> lock(registry_mutex());
+            return blocks().size();
+        }
+
+        static void print_table(ostream& out, const totals& t, double seconds) {
+            auto flags = out.flags();
+            auto precision = out.precision();
+            out << "Render statistics (" << fixed << setprecision(3) << seconds << " s)\n";
+            auto row = [&](const char* name, uint64_t value, const string& note = "") {
+                out << "  " << left << setw(16) << name << right << setw(14) << value << "  " << note << '\n';
+            };
+            auto per_ray = [&](uint64_t value) {
+                return t.rays() > 0 ? to_string_fixed(static_cast<double>(value) / t.rays()) + " per ray" : string();
+            };
+
+            row("rays", t.rays(), t.rays() > 0 && seconds > 0 ? to_string_fixed(t.rays() / seconds / 1e6) + " Mrays/s" : "");
+            for (int c = camera_rays; c <= shadow_rays; c++) row(names[c], t.value[c]);
+            row(names[bvh_nodes], t[bvh_nodes], per_ray(t[bvh_nodes]));
+            row(names[aabb_tests], t[aabb_tests], per_ray(t[aabb_tests]));
+            for (int c = sphere_tests; c < num_counters; c += 2) {
+                auto tests = t.value[c], hits = t.value[c+1];
+                row(names[c], tests, per_ray(tests));
+                row(names[c+1], hits, tests > 0 ? to_string_fixed(100.0 * hits / tests) + " % of tests" : "");
+            }
+            out.flags(flags);
+            out.precision(precision);
+        }
+
+        static void write_json(ostream& out, const totals& t, double seconds) {
+            auto flags = out.flags();
+            auto precision = out.precision();
+            out << "{\"seconds\": " << fixed << setprecision(6) << seconds
+                << ", \"rays\": " << t.rays()
+                << ", \"rays_per_second\": " << (seconds > 0 ? t.rays() / seconds : 0.0);
+            for (int c = 0; c < num_counters; c++)
+                out << ", \"" << names[c] << "\": " << t.value[c];
+            out << "}\n";
+            out.flags(flags);
+            out.precision(precision);
+        }
+
+    private:
+        struct block { uint64_t value[num_counters] = {}; };
+
+        struct block_owner {
+            block* b = nullptr;
+            block** local = nullptr; // the thread's pointer in local()
+            ~block_owner() {
+                if (!b) return;
+                retire(b);
+                *local = nullptr;
+            }
+        };
+
+        static block& local() {
+            // Constant initialized, so the fast path is a plain thread local load (no guard variable to check)
+            static thread_local block* b = nullptr;
+            if (__builtin_expect(b == nullptr, 0)) b = register_block(&b);
+            return *b;
+        }
+
+        static block* register_block(block** local) {
+            static thread_local block_owner owner; // destroyed when the thread exits, see retire
+            lock_guard<mutex> lock(registry_mutex());
+            blocks().push_back(make_unique<block>());
+            owner.b = blocks().back().get();
+            owner.local = local;
+            return owner.b;
+        }
+
+        static void retire(block* b) {
+            lock_guard<mutex> lock(registry_mutex());
+            for (int c = 0; c < num_counters; c++) retired().value[c] += b->value[c];
+            for (size_t k = 0; k < blocks().size(); k++) {
+                if (blocks()[k].get() != b) continue;
+                blocks()[k] = std::move(blocks().back());
+                blocks().pop_back();
+                break;
+            }
+        }
+
+        static block& retired() {
+            static block sum;
+            return sum;
+        }
+
+        static vector<unique_ptr<block>>& blocks() {
+            static vector<unique_ptr<block>> all;
+            return all;
+        }
+
+        static mutex& registry_mutex() {
+            static mutex m;
+            return m;
+        }
+
+        static string to_string_fixed(double x) {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%.2f", x);
+            return buffer;
+        }
+};
+
+#define RT_RAY(name) render_stats::add(render_stats::name) // always on, see render_stats
+
+#ifdef RT_STATS
+#define RT_STAT(name) render_stats::add(render_stats::name)
+#define RT_STAT_ADD(counter, n) render_stats::add(counter, n) // for counters picked at runtime & batched counts
+#else
+#define RT_STAT(name) ((void)0)
+#define RT_STAT_ADD(counter, n) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+// Work-stealing thread pool
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class thread_pool {
+    // Every worker owns a deque of tasks. A worker pops from the back of its own deque (most recently pushed,
+    // --> still warm in cache) and, when it runs dry, steals from the front of somebody else's deque.
+    // --> That way a few expensive tasks (tiles full of glass & smoke) do not stall the idle workers.
+
+    public:
+        // Constructors
+        thread_pool(int num_threads = 0) {
+            if (num_threads <= 0) num_threads = static_cast<int>(thread::hardware_concurrency());
+            if (num_threads <= 0) num_threads = 1;
+
+            for (int i = 0; i < num_threads; i++) queues.push_back(make_unique<task_queue>());
+            for (int i = 0; i < num_threads; i++) workers.emplace_back([this, i] { worker_loop(i); });
+        }
+
+        // Destructor
+        ~thread_pool() {
+            {
+                lock_guard<mutex> lock(wake_mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto& w : workers) w.join();
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        // Functions
+        int size() const { return static_cast<int>(workers.size()); }
+
+        void submit(function<void()> task) {
+            // Tasks submitted from a worker go to its own deque, tasks from outside are dealt out round-robin.
+            int q = (current_pool() == this) ? current_worker() : static_cast<int>(next_queue++ % queues.size());
+            pending++;
+            {
+                lock_guard<mutex> lock(queues[q]->m);
+                queues[q]->tasks.push_back(std::move(task));
+            }
+            {
+                lock_guard<mutex> lock(wake_mutex); // prevents a lost wake-up between a worker's check and its wait
+                queued++;
+            }
+            wake.notify_one();
+        }
+
+        void wait() {
+            // Blocks until every submitted task has finished. The calling thread helps out in the meantime.
+            function<void()> task;
+            while (pending > 0) {
+                if (steal(-1, task)) {
+                    run(task);
+                } else {
+                    unique_lock<mutex> lock(wake_mutex);
+                    done.wait_for(lock, chrono::milliseconds(1), [this] { return pending == 0; });
+                }
+            }
+        }
+
+        template <typename condition>
+        void wait_until(condition done) {
+            // Like wait(), but only until done() returns true, so a task can wait for the tasks it submitted itself
+            // --> (wait() would wait for the task that calls it as well)
+            function<void()> task;
+            int self = (current_pool() == this) ? current_worker() : -1;
+            while (!done()) {
+                if ((self >= 0 && pop_own(self, task)) || steal(self, task)) run(task);
+                else this_thread::yield();
+            }
+        }
+
+        template <typename index_function>
+        void parallel_for(size_t n, size_t grain, index_function fn) {
+            // Calls fn(i) for every i in [0,n), in chunks of grain indices per task, and waits until all are done
+            if (grain < 1) grain = 1;
+            for (size_t begin = 0; begin < n; begin += grain) {
+                size_t end = std::min(begin + grain, n);
+                submit([begin, end, &fn] {
+                    for (size_t i = begin; i < end; i++) fn(i);
+                });
+            }
+            wait();
+        }
+
+        static int current_worker() {
+            // Index of the calling worker thread in its pool, -1 if the caller is not a pool thread
+            return worker_index();
+        }
+
+    private:
+        struct task_queue {
+            mutex m;
+            deque<function<void()>> tasks;
+        };
+
+        vector<unique_ptr<task_queue>> queues;
+        vector<thread> workers;
+        atomic<int> pending{0}; // submitted, but not yet finished
+        atomic<int> queued{0};  // submitted, but not yet picked up by anybody
+        atomic<unsigned int> next_queue{0};
+        mutex wake_mutex;
+        condition_variable wake;
+        condition_variable done;
+        bool stopping = false;
+
+        static int& worker_index() { thread_local int index = -1; return index; }
+        static thread_pool*& current_pool() { thread_local thread_pool* pool = nullptr; return pool; }
+
+        bool pop_own(int i, function<void()>& task) {
+            lock_guard<mutex> lock(queues[i]->m);
+            if (queues[i]->tasks.empty()) return false;
+            task = std::move(queues[i]->tasks.back());
+            queues[i]->tasks.pop_back();
+            queued--;
+            return true;
+        }
+
+        bool steal(int thief, function<void()>& task) {
+            int n = static_cast<int>(queues.size());
+            int start = (thief < 0) ? 0 : thief + 1;
+            for (int k = 0; k < n; k++) {
+                int victim = (start + k) % n;
+                if (victim == thief) continue;
+                lock_guard<mutex> lock(queues[victim]->m);
+                if (queues[victim]->tasks.empty()) continue;
+                task = std::move(queues[victim]->tasks.front());
+                queues[victim]->tasks.pop_front();
+                queued--;
+                return true;
+            }
+            return false;
+        }
+
+        void run(function<void()>& task) {
+            task();
+            task = nullptr;
+            if (--pending == 0) {
+                lock_guard<mutex> lock(wake_mutex);
+                done.notify_all();
+            }
+        }
+
+        void worker_loop(int i) {
+            worker_index() = i;
+            current_pool() = this;
+            function<void()> task;
+            while (true) {
+                if (pop_own(i, task) || steal(i, task)) {
+                    run(task);
+                    continue;
+                }
+                unique_lock<mutex> lock(wake_mutex);
+                wake.wait(lock, [this] { return stopping || queued > 0; });
+                if (stopping) return;
+            }
+        }
+};
+
+#endif
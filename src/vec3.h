@@ -153,9 +153,12 @@ inline vec3 random_in_unit_disk() { // Using polar coordinates
 
 // Just using spherical coordinates
 inline vec3 random_unit_vector() {
-    auto theta = random_double(0.0, pi);
+    // cos(theta) has to be uniform in [-1,1], not theta in [0,pi] --> otherwise the directions pile up at the poles
+    // --> and normal + random_unit_vector() is not cosine distributed (which lambertian::scattering_pdf relies on)
+    auto z = random_double(-1.0, 1.0);
     auto phi = random_double(0.0, 2*pi);
-    return vec3(sin(theta)*cos(phi), sin(theta)*sin(phi), cos(theta));
+    auto r = sqrt(fmax(0.0, 1 - z*z));
+    return vec3(r*cos(phi), r*sin(phi), z);
 }
 
 inline vec3 random_on_hemisphere(const vec3& normal) { // Last part of random reflection
@@ -0,0 +1,215 @@
+// Wide BVH --> bvh_node's binary tree collapsed into nodes of 4 or 8 children, all tested against a ray at once
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include "bvh.h"
+
+#include <cstdint>
+#include <vector>
+
+template <int N>
+class wide_bvh : public hittable {
+    // A node keeps the boxes of its up to N children in structure-of-arrays form (the min x of all children, then
+    // --> their min y, ...), so simd_double tests the ray against several children per instruction: 4 with AVX, 2
+    // --> with SSE2. The float bounds are widened to doubles, the test is the one of bvh_node, so both trees find
+    // --> exactly the same hits. The binary tree is collapsed top-down: a node takes over the children of its
+    // --> largest interior child until it has N of them. The children a ray hits are visited nearest first, and a
+    // --> child whose box starts beyond the closest hit found in the meantime is skipped.
+    static_assert(N == 4 || N == 8, "a wide_bvh has 4 or 8 children per node");
+
+    public:
+        // Constructors
+        wide_bvh(const hittable_list& list, const bvh_settings& settings = bvh_node::default_settings) {
+            bvh_node binary(list, settings);
+            auto start = std::chrono::steady_clock::now();
+            bbox = binary.bbox;
+            random_hits = binary.random_hits;
+            objects = std::move(binary.objects);
+            if (!binary.nodes.empty()) collapse(binary, 0);
+            if (settings.report_objects > 0 && objects.size() >= settings.report_objects) {
+                clog << "BVH collapsed to " << N << " children per node: " << static_cast<long>(
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()) << " ms\n";
+            }
+        }
+
+        // Functions
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            return traverse(r, ray_t, rec, 0);
+        }
+
+        void hit_packet(ray_packet& packet, uint32_t mask, hit_record* recs) const override {
+            // Like bvh_node::hit_packet: the packet stays together while enough of its rays go the same way
+            if (nodes.empty()) return;
+            struct packet_entry { uint32_t child, count, mask; };
+            packet_entry stack[stack_size];
+            int top = 0;
+            stack[top++] = {0, 0, mask};
+            while (top > 0) {
+                packet_entry e = stack[--top];
+                if (e.count > 0) {
+                    for (uint32_t k = e.child; k < e.child + e.count; k++) objects[k]->hit_packet(packet, e.mask, recs);
+                    continue;
+                }
+                if (ray_packet::count(e.mask) < min_packet_rays) {
+                    for (int k = 0; k < packet.size; k++) {
+                        if (!(e.mask & (1u << k))) continue;
+                        hit_record temp_rec;
+                        if (traverse(packet.rays[k], interval(packet.t_min[k], packet.t_max[k]), temp_rec, e.child)) {
+                            recs[k] = temp_rec;
+                            packet.t_max[k] = temp_rec.t;
+                            packet.hit[k] = true;
+                        }
+                    }
+                    continue;
+                }
+                const node& n = nodes[e.child];
+                RT_STAT_ADD(render_stats::bvh_nodes, ray_packet::count(e.mask)); // counted per ray, like hit()
+                for (int c = n.size - 1; c >= 0; c--) { // the first child ends up on top
+                    aabb box(interval(n.bounds[0][c], n.bounds[3][c]), interval(n.bounds[1][c], n.bounds[4][c]),
+                             interval(n.bounds[2][c], n.bounds[5][c]));
+                    uint32_t active = box.hit_packet(packet, e.mask);
+                    if (active != 0) stack[top++] = {n.child[c], n.count[c], active};
+                }
+            }
+        }
+
+        aabb bounding_box() const override { return bbox; }
+
+        bool random_hit() const override { return random_hits; }
+
+        size_t node_count() const { return nodes.size(); }
+
+    private:
+        struct alignas(64) node {
+            float bounds[6][N]; // min x, y, z, max x, y, z of every child
+            uint32_t child[N];  // Interior child: its node, leaf: its first object
+            uint16_t count[N];  // Objects of a leaf, 0 for an interior child
+            uint8_t size;       // Children in use, the boxes of the others are empty
+        };
+
+        struct entry { uint32_t child, count; double t; }; // t: where the ray enters the child's box
+
+        vector<node> nodes;
+        vector<shared_ptr<hittable>> objects;
+        aabb bbox;
+        bool random_hits = false;
+
+        static constexpr int min_packet_rays = 4;
+        // Every node visited pushes at most N entries and a node is at least one level of the binary tree down
+        static constexpr int stack_size = bvh_node::stack_size * N;
+
+        bool traverse(const ray& r, interval ray_t, hit_record& rec, uint32_t root) const {
+            if (nodes.empty()) return false;
+            simd_double orig[3] = {r.origin().x(), r.origin().y(), r.origin().z()};
+            simd_double inv_dir[3] = {1 / r.direction().x(), 1 / r.direction().y(), 1 / r.direction().z()};
+            int near_side[3], far_side[3]; // the box side a ray enters through, per axis
+            for (int a = 0; a < 3; a++) {
+                bool negative = 1 / r.direction()[a] < 0;
+                near_side[a] = negative ? a + 3 : a;
+                far_side[a] = negative ? a : a + 3;
+            }
+
+            entry stack[stack_size];
+            int top = 0;
+            stack[top++] = {root, 0, ray_t.min};
+            bool hit_anything = false;
+            while (top > 0) {
+                entry e = stack[--top];
+                if (e.t >= ray_t.max) continue; // a closer hit was found since the box was tested
+                if (e.count > 0) {
+                    for (uint32_t k = e.child; k < e.child + e.count; k++) {
+                        if (objects[k]->hit(r, ray_t, rec)) {
+                            hit_anything = true;
+                            ray_t.max = rec.t;
+                        }
+                    }
+                    continue;
+                }
+
+                const node& n = nodes[e.child];
+                RT_STAT(bvh_nodes);
+                RT_STAT_ADD(render_stats::aabb_tests, n.size);
+                alignas(32) double t_near[N];
+                int hits = 0;
+                for (int k = 0; k < N; k += simd_double::width) {
+                    // the slab test of bvh_node::hit_box for simd_double::width children at once
+                    simd_double t_min = ray_t.min, t_max = ray_t.max;
+                    for (int a = 0; a < 3; a++) {
+                        simd_double t0 = (simd_double::load(n.bounds[near_side[a]] + k) - orig[a]) * inv_dir[a];
+                        simd_double t1 = (simd_double::load(n.bounds[far_side[a]] + k) - orig[a]) * inv_dir[a];
+                        t_min = max(t_min, t0); // a NaN (0 * infinity) keeps the first argument
+                        t_max = min(t_max, t1);
+                    }
+                    t_min.store(t_near + k);
+                    hits |= (t_min < t_max) << k;
+                }
+
+                // hit children sorted by distance, pushed far to near
+                int order[N], count = 0;
+                for (int c = 0; c < n.size; c++) {
+                    if (!(hits & (1 << c))) continue;
+                    int j = count++;
+                    while (j > 0 && t_near[order[j-1]] < t_near[c]) {
+                        order[j] = order[j-1];
+                        j--;
+                    }
+                    order[j] = c;
+                }
+                for (int j = 0; j < count; j++)
+                    stack[top++] = {n.child[order[j]], n.count[order[j]], t_near[order[j]]};
+            }
+            return hit_anything;
+        }
+
+        uint32_t collapse(const bvh_node& binary, uint32_t root) {
+            // The children of the new node: starting from root, the interior child with the largest box is replaced by
+            // --> its two children, until there are N of them or only leaves are left
+            vector<uint32_t> children = {root};
+            while (static_cast<int>(children.size()) < N) {
+                int best = -1;
+                double best_area = -1;
+                for (size_t c = 0; c < children.size(); c++) {
+                    const auto& b = binary.nodes[children[c]];
+                    if (b.count > 0) continue;
+                    double area = b.box().surface_area();
+                    if (area > best_area) {
+                        best_area = area;
+                        best = static_cast<int>(c);
+                    }
+                }
+                if (best < 0) break;
+                uint32_t expanded = children[best];
+                children[best] = expanded + 1; // its left child
+                children.insert(children.begin() + best + 1, binary.nodes[expanded].index);
+            }
+
+            uint32_t self = static_cast<uint32_t>(nodes.size());
+            node n;
+            for (int a = 0; a < 6; a++)
+                for (int c = 0; c < N; c++) n.bounds[a][c] = (a < 3) ? INFINITY : -INFINITY; // empty
+            for (int c = 0; c < N; c++) {
+                n.child[c] = 0;
+                n.count[c] = 0;
+            }
+            n.size = static_cast<uint8_t>(children.size());
+            nodes.push_back(n);
+
+            for (size_t c = 0; c < children.size(); c++) {
+                const auto& b = binary.nodes[children[c]];
+                uint32_t child = (b.count > 0) ? b.index : collapse(binary, children[c]); // (nodes may reallocate)
+                for (int a = 0; a < 6; a++) nodes[self].bounds[a][c] = b.bounds[a];
+                nodes[self].child[c] = child;
+                nodes[self].count[c] = b.count;
+            }
+            return self;
+        }
+};
+
+inline shared_ptr<hittable> make_bvh(const hittable_list& list, const bvh_settings& settings = bvh_node::default_settings) {
+    // A BVH over list, with the settings' number of children per node
+    if (settings.width == 4) return make_shared<wide_bvh<4>>(list, settings);
+    if (settings.width == 8) return make_shared<wide_bvh<8>>(list, settings);
+    return make_shared<bvh_node>(list, settings);
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include "../src/general.h"
+#include "../src/wide_bvh.h"
+#include "../src/mesh.h"
+#include "../src/sphere.h"
+#include "../src/material.h"
+
+static hittable_list random_scene(int triangles) {
+  // Small random triangles (u & v in all directions) and a few spheres, one of them huge like a ground sphere
+  auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+  hittable_list objects;
+  for (int i = 0; i < triangles; i++) {
+    point3 q(random_double(-5, 5), random_double(-5, 5), random_double(-5, 5));
+    objects.add(make_shared<triangle>(q, random_unit_vector(), 0.5 * random_unit_vector(), mat));
+  }
+  for (int i = 0; i < 20; i++)
+    objects.add(make_shared<sphere>(point3(random_double(-5, 5), random_double(-5, 5), random_double(-5, 5)), 0.3, mat));
+  objects.add(make_shared<sphere>(point3(0, -1006, 0), 1000, mat));
+  return objects;
+}
+
+TEST(BvhTest, closesthittest) {
+  // Every builder finds the same closest hit as testing all objects
+  thread_sampler().seed = 7;
+  thread_sampler().start_pixel_sample(0, 0);
+  auto objects = random_scene(2000);
+  bvh_settings median, sah, sah_leaf1, lbvh, wide4, wide8;
+  median.split = bvh_split::median;
+  sah_leaf1.max_leaf_size = 1;
+  lbvh.split = bvh_split::lbvh;
+  wide4.width = 4;
+  wide8.width = 8;
+  vector<shared_ptr<hittable>> trees = {
+    make_bvh(objects, median), make_bvh(objects, sah), make_bvh(objects, sah_leaf1), make_bvh(objects, lbvh),
+    make_bvh(objects, wide4), make_bvh(objects, wide8)
+  };
+
+  int hits = 0;
+  for (int i = 0; i < 5000; i++) {
+    ray r(point3(random_double(-8, 8), random_double(-8, 8), random_double(-8, 8)), random_unit_vector());
+    hit_record expected;
+    bool hit = objects.hit(r, interval(0.001, infinity), expected);
+    hits += hit;
+    for (const auto& tree : trees) {
+      hit_record rec;
+      ASSERT_EQ(tree->hit(r, interval(0.001, infinity), rec), hit);
+      if (hit) {
+        ASSERT_EQ(rec.t, expected.t);
+      }
+    }
+  }
+  ASSERT_GT(hits, 1000);
+  ASSERT_EQ(trees[1]->bounding_box().y.min, objects.bounding_box().y.min);
+}
+
+TEST(BvhTest, packettest) {
+  // A packet finds the hits its rays find one by one, also when they go separate ways further down the tree
+  thread_sampler().seed = 8;
+  thread_sampler().start_pixel_sample(0, 0);
+  auto objects = random_scene(500);
+  bvh_node tree(objects);
+  wide_bvh<4> wide(objects);
+  ASSERT_LT(tree.node_count(), 2 * objects.objects.size());
+  ASSERT_LT(wide.node_count(), tree.node_count() / 2);
+
+  for (int p = 0; p < 200; p++) {
+    point3 origin(random_double(-8, 8), random_double(-8, 8), random_double(-8, 8));
+    vec3 target = 3 * random_unit_vector() - origin;
+    ray_packet packet;
+    for (int k = 0; k < ray_packet::max_size; k++)
+      packet.add(ray(origin, target + (p % 2 ? 0.05 : 2.0) * random_unit_vector()), interval(0.001, infinity));
+    ray_packet wide_packet = packet;
+    hit_record recs[ray_packet::max_size], wide_recs[ray_packet::max_size];
+    tree.hit_packet(packet, packet.full_mask(), recs);
+    wide.hit_packet(wide_packet, wide_packet.full_mask(), wide_recs);
+    for (int k = 0; k < packet.size; k++) {
+      hit_record rec;
+      bool hit = tree.hit(packet.rays[k], interval(0.001, infinity), rec);
+      ASSERT_EQ(packet.hit[k], hit);
+      ASSERT_EQ(wide_packet.hit[k], hit);
+      if (hit) {
+        ASSERT_EQ(recs[k].t, rec.t);
+        ASSERT_EQ(wide_recs[k].t, rec.t);
+      }
+    }
+  }
+}
+
+TEST(BvhTest, paralleltest) {
+  // Builds on several threads give the trees of a single thread
+  thread_sampler().seed = 9;
+  thread_sampler().start_pixel_sample(0, 0);
+  auto objects = random_scene(40000);
+  for (auto split : {bvh_split::sah, bvh_split::lbvh}) {
+    bvh_settings one, four;
+    one.split = four.split = split;
+    one.threads = 1;
+    four.threads = 4;
+    bvh_node a(objects, one), b(objects, four);
+    ASSERT_EQ(a.node_count(), b.node_count());
+    for (int i = 0; i < 300; i++) {
+      ray r(point3(random_double(-8, 8), random_double(-8, 8), random_double(-8, 8)), random_unit_vector());
+      hit_record expected, rec_a, rec_b;
+      bool hit = objects.hit(r, interval(0.001, infinity), expected);
+      ASSERT_EQ(a.hit(r, interval(0.001, infinity), rec_a), hit);
+      ASSERT_EQ(b.hit(r, interval(0.001, infinity), rec_b), hit);
+      if (hit) {
+        ASSERT_EQ(rec_a.t, expected.t);
+        ASSERT_EQ(rec_b.t, expected.t);
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+
+#include "../src/general.h"
+#include "../src/bvh.h"
+#include "../src/camera.h"
+#include "../src/constant_medium.h"
+#include "../src/hittable_list.h"
+#include "../src/material.h"
+#include "../src/quad.h"
+#include "../src/sphere.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// Small fixed-seed renders that have to come out the same whichever way they are computed
+
+static hittable_list smoke_scene() {
+  hittable_list objects;
+  objects.add(make_shared<sphere>(point3(0, -100.5, 2), 100, make_shared<lambertian>(color(0.5, 0.5, 0.5))));
+  objects.add(make_shared<sphere>(point3(-0.6, 0, 2), 0.5, make_shared<metal>(color(0.8, 0.6, 0.2), 0.1)));
+  auto boundary = make_shared<sphere>(point3(0.6, 0, 2), 0.5, make_shared<dielectric>(1.5));
+  objects.add(make_shared<constant_medium>(boundary, 2.0, color(0.2, 0.4, 0.9)));
+  hittable_list world;
+  world.add(make_shared<bvh_node>(objects));
+  return world;
+}
+
+static camera small_camera(const string& output_path) {
+  camera cam;
+  cam.image_width = 24;
+  cam.samples_per_pixel = 8;
+  cam.max_depth = 5;
+  cam.vfov = 60;
+  cam.lookfrom = point3(0, 0.5, -1);
+  cam.lookat = point3(0, 0, 2);
+  cam.background = color(0.7, 0.8, 1.0);
+  cam.seed = 7;
+  cam.output_path = output_path;
+  return cam;
+}
+
+static image read_image(const string& path) {
+  image img;
+  EXPECT_TRUE(read_pfm(path, img)) << path;
+  return img;
+}
+
+static void expect_same(const string& a, const string& b) {
+  image x = read_image(a), y = read_image(b);
+  ASSERT_EQ(x.width, y.width);
+  ASSERT_EQ(x.height, y.height);
+  ASSERT_EQ(x.rgb, y.rgb) << a << " and " << b << " differ";
+}
+
+TEST(CameraTest, packets_with_smoke) {
+  // Volumes draw random numbers while being intersected, packets must not change the image
+  auto world = smoke_scene();
+  camera packets = small_camera("/tmp/camera_test_packets.pfm");
+  packets.display(world);
+  camera scalar = small_camera("/tmp/camera_test_scalar.pfm");
+  scalar.ray_packets = false;
+  scalar.display(world);
+  expect_same(packets.output_path, scalar.output_path);
+}
+
+static string file_contents(const string& path) {
+  ifstream in(path, ios::binary);
+  return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+TEST(CameraTest, mismatched_resume_refused) {
+  // A checkpoint of other sample settings is neither resumed from nor overwritten, and render() says so
+  auto world = smoke_scene();
+  const string checkpoint_path = "/tmp/camera_test_refused.rtc";
+  remove(checkpoint_path.c_str());
+  camera first = small_camera("/tmp/camera_test_refused.pfm");
+  first.checkpoint_path = checkpoint_path;
+  ASSERT_TRUE(first.render(world));
+  string saved = file_contents(checkpoint_path);
+  ASSERT_FALSE(saved.empty());
+
+  camera other = small_camera("/tmp/camera_test_refused.pfm");
+  other.checkpoint_path = checkpoint_path;
+  other.resume = true;
+  other.samples_per_pixel = 16;
+  EXPECT_FALSE(other.render(world));
+  other.samples_per_pixel = 8;
+  other.sampling = sample_pattern::sobol;
+  EXPECT_FALSE(other.render(world));
+  EXPECT_EQ(file_contents(checkpoint_path), saved);
+
+  other.sampling = sample_pattern::independent;
+  EXPECT_TRUE(other.render(world));
+}
+
+TEST(CameraTest, unwritable_output_fails) {
+  auto world = smoke_scene();
+  camera cam = small_camera("/nonexistent/camera_test.pfm");
+  EXPECT_FALSE(cam.render(world));
+  EXPECT_FALSE(cam.display(world));
+  cam.output_path = "/tmp/camera_test_written.pfm";
+  cam.sample_map_path = "/nonexistent/camera_test_samples.pfm";
+  EXPECT_FALSE(cam.render(world));
+}
+
+TEST(CameraTest, adaptive_threads) {
+  // Adaptive sampling decides per pixel, that must not depend on the threads or how the image is tiled
+  auto world = smoke_scene();
+  camera one = small_camera("/tmp/camera_test_adaptive1.pfm");
+  one.samples_per_pixel = 64;
+  one.adaptive = true;
+  one.min_samples = 8;
+  one.adaptive_tolerance = 0.05;
+  one.num_threads = 1;
+  one.sample_map_path = "/tmp/camera_test_adaptive1_samples.pfm";
+  ASSERT_TRUE(one.render(world));
+
+  camera four = one;
+  four.num_threads = 4;
+  four.tile_size = 5;
+  four.output_path = "/tmp/camera_test_adaptive4.pfm";
+  four.sample_map_path = "/tmp/camera_test_adaptive4_samples.pfm";
+  ASSERT_TRUE(four.render(world));
+  expect_same(one.output_path, four.output_path);
+  expect_same(one.sample_map_path, four.sample_map_path);
+
+  // The flat sky converges with its first round, the smoke needs more, no pixel gets more than samples_per_pixel
+  uint64_t pixels = 24 * 24;
+  EXPECT_EQ(one.samples_taken(), four.samples_taken());
+  EXPECT_GE(one.samples_taken(), pixels * 8);
+  EXPECT_LT(one.samples_taken(), pixels * 64);
+  image map = read_image(one.sample_map_path);
+  float lowest = 1, highest = 0;
+  for (float v : map.rgb) {
+    lowest = fmin(lowest, v);
+    highest = fmax(highest, v);
+  }
+  EXPECT_FLOAT_EQ(lowest, 8.0f / 64);
+  EXPECT_LE(highest, 1.0f);
+  EXPECT_GT(highest, lowest);
+}
+
+TEST(CameraTest, resume_matches_uninterrupted) {
+  // A render killed halfway leaves a checkpoint with some tiles done, here the tiles of part 0 of 2. Resuming
+  // from it must give the image of a render that was never interrupted.
+  auto world = smoke_scene();
+  camera whole = small_camera("/tmp/camera_test_whole.pfm");
+  whole.tile_size = 8;
+  ASSERT_TRUE(whole.render(world));
+
+  const string checkpoint_path = "/tmp/camera_test_killed.rtc";
+  remove(checkpoint_path.c_str());
+  camera killed = small_camera("/tmp/camera_test_killed.pfm");
+  killed.tile_size = 8;
+  killed.checkpoint_path = checkpoint_path;
+  killed.part_count = 2;
+  ASSERT_TRUE(killed.render(world));
+  EXPECT_EQ(killed.samples_taken(), 5u * 8 * 8 * 8); // tiles 0, 2, 4, 6 & 8 of the 3x3
+
+  camera resumed = small_camera("/tmp/camera_test_resumed.pfm");
+  resumed.tile_size = 8;
+  resumed.checkpoint_path = checkpoint_path;
+  resumed.resume = true;
+  resumed.num_threads = 4;
+  ASSERT_TRUE(resumed.render(world));
+  EXPECT_EQ(resumed.samples_taken(), whole.samples_taken());
+  expect_same(whole.output_path, resumed.output_path);
+}
+
+TEST(CameraTest, progressive_matches_normal) {
+  // Passes of 1, 2, 4, ... samples per pixel (the last one cut to samples_per_pixel) add up to the normal render
+  auto world = smoke_scene();
+  camera normal = small_camera("/tmp/camera_test_normal.pfm");
+  normal.samples_per_pixel = 10;
+  ASSERT_TRUE(normal.render(world));
+
+  camera progressive = normal;
+  progressive.progressive = true;
+  progressive.output_path = "/tmp/camera_test_progressive.pfm";
+  stringstream log;
+  auto old = clog.rdbuf(log.rdbuf());
+  bool ok = progressive.render(world);
+  clog.rdbuf(old);
+  ASSERT_TRUE(ok);
+  expect_same(normal.output_path, progressive.output_path);
+
+  vector<string> passes;
+  string line;
+  while (getline(log, line)) {
+    auto at = line.find("Pass ");
+    if (at != string::npos && line.find("with") != string::npos) passes.push_back(line.substr(at, line.find(" with") - at));
+  }
+  EXPECT_EQ(passes, vector<string>({"Pass 1 (1 spp)", "Pass 2 (2 spp)", "Pass 3 (4 spp)", "Pass 4 (8 spp)", "Pass 5 (10 spp)"}));
+}
+
+TEST(CameraTest, wavefront_matches_tiled) {
+  // The wavefront renderer follows the same paths in another order, with Russian roulette or without it
+  auto world = smoke_scene();
+  for (int roulette_depth : {2, -1}) {
+    camera tiled = small_camera("/tmp/camera_test_tiled.pfm");
+    tiled.max_depth = 12;
+    tiled.roulette_depth = roulette_depth;
+    tiled.num_threads = 1;
+    ASSERT_TRUE(tiled.render(world));
+
+    camera wavefront = tiled;
+    wavefront.wavefront = true;
+    wavefront.wavefront_batch = 1000; // several batches, the last one cut short
+    wavefront.num_threads = 4;
+    wavefront.output_path = "/tmp/camera_test_wavefront.pfm";
+    ASSERT_TRUE(wavefront.render(world));
+    SCOPED_TRACE("roulette_depth " + to_string(roulette_depth));
+    expect_same(tiled.output_path, wavefront.output_path);
+  }
+}
+
+TEST(CameraTest, denoise_threads) {
+  // The feature buffers and the denoised image do not depend on the threads, and the denoiser does smooth the noise
+  auto world = smoke_scene();
+  camera one = small_camera("/tmp/camera_test_denoised1.pfm");
+  one.denoise = true;
+  one.num_threads = 1;
+  one.albedo_path = "/tmp/camera_test_albedo1.pfm";
+  one.normal_path = "/tmp/camera_test_normal1.pfm";
+  ASSERT_TRUE(one.render(world));
+
+  camera four = one;
+  four.num_threads = 4;
+  four.output_path = "/tmp/camera_test_denoised4.pfm";
+  four.albedo_path = "/tmp/camera_test_albedo4.pfm";
+  four.normal_path = "/tmp/camera_test_normal4.pfm";
+  ASSERT_TRUE(four.render(world));
+  expect_same(one.output_path, four.output_path);
+  expect_same(one.albedo_path, four.albedo_path);
+  expect_same(one.normal_path, four.normal_path);
+
+  camera noisy = one;
+  noisy.denoise = false;
+  noisy.output_path = "/tmp/camera_test_noisy.pfm";
+  ASSERT_TRUE(noisy.render(world));
+  auto roughness = [](const image& img) { // sum of the differences between horizontal neighbours
+    double sum = 0;
+    for (int j = 0; j < img.height; j++)
+      for (int i = 1; i < img.width; i++)
+        for (int c = 0; c < 3; c++) sum += fabs(img.pixel(i, j)[c] - img.pixel(i-1, j)[c]);
+    return sum;
+  };
+  EXPECT_LT(roughness(read_image(one.output_path)), roughness(read_image(noisy.output_path)));
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include "../src/general.h"
+#include "../src/camera.h"
+#include "../src/checkpoint.h"
+#include "../src/hittable_list.h"
+#include "../src/material.h"
+#include "../src/sphere.h"
+
+static camera test_camera() {
+  camera cam;
+  cam.image_width = 24;
+  cam.samples_per_pixel = 6;
+  cam.max_depth = 4;
+  cam.tile_size = 4;
+  cam.num_threads = 2;
+  cam.seed = 9;
+  cam.background = color(0.7, 0.8, 1.0);
+  return cam;
+}
+
+TEST(DistributeTest, mergetest) {
+  // Tile sets times sample ranges add up to the samples of the whole render
+  hittable_list world;
+  world.add(make_shared<sphere>(point3(0, 0, 1), 0.6, make_shared<lambertian>(color(0.5, 0.3, 0.2))));
+
+  camera whole = test_camera();
+  whole.partial_path = "/tmp/distribute_test_whole.rtp";
+  whole.render(world);
+
+  framebuffer sum;
+  sample_settings settings;
+  for (int t = 0; t < 3; t++) {
+    for (int s = 0; s < 2; s++) {
+      camera cam = test_camera();
+      cam.part_index = t;
+      cam.part_count = 3;
+      cam.sample_part = s;
+      cam.sample_part_count = 2;
+      cam.partial_path = "/tmp/distribute_test_part.rtp";
+      cam.render(world);
+      ASSERT_TRUE(checkpoint::add(cam.partial_path, sum, settings));
+    }
+  }
+  ASSERT_EQ(settings.seed, 9u);
+
+  framebuffer expected(24, 24);
+  ASSERT_TRUE(checkpoint::load(whole.partial_path, expected, whole.checkpoint_settings()));
+  for (size_t idx = 0; idx < expected.sample_count.size(); idx++) {
+    ASSERT_EQ(sum.sample_count[idx], 6);
+    ASSERT_NEAR(sum.color_sum[idx].x(), expected.color_sum[idx].x(), 1e-9);
+    ASSERT_NEAR(sum.color_sum[idx].z(), expected.color_sum[idx].z(), 1e-9);
+  }
+
+  // A part of another render does not fit
+  camera other = test_camera();
+  other.seed = 10;
+  other.partial_path = "/tmp/distribute_test_other.rtp";
+  other.render(world);
+  ASSERT_FALSE(checkpoint::add(other.partial_path, sum, settings));
+
+  // Nor does a resume with another sample count or pattern: the checkpoint is left alone
+  framebuffer resumed(24, 24);
+  camera more = test_camera();
+  more.samples_per_pixel = 8;
+  ASSERT_FALSE(checkpoint::load(whole.partial_path, resumed, more.checkpoint_settings()));
+  camera sobol = test_camera();
+  sobol.sampling = sample_pattern::sobol;
+  ASSERT_FALSE(checkpoint::load(whole.partial_path, resumed, sobol.checkpoint_settings()));
+  ASSERT_EQ(resumed.sample_count[0], 0);
+  ASSERT_TRUE(checkpoint::load(whole.partial_path, resumed, test_camera().checkpoint_settings()));
+}
+
+TEST(DistributeTest, croptest) {
+  // A crop window traces the same samples as the full render, only fewer pixels
+  hittable_list world;
+  world.add(make_shared<sphere>(point3(0, 0, 1), 0.6, make_shared<lambertian>(color(0.5, 0.3, 0.2))));
+
+  camera whole = test_camera();
+  whole.partial_path = "/tmp/distribute_test_whole.rtp";
+  whole.render(world);
+  camera cam = test_camera();
+  cam.crop.x0 = 0.25;
+  cam.crop.y0 = 0.5;
+  cam.crop.x1 = 0.5;
+  cam.crop.y1 = 1;
+  cam.crop.normalized = true;
+  cam.partial_path = "/tmp/distribute_test_crop.rtp";
+  cam.render(world);
+
+  framebuffer full(24, 24), crop(24, 24);
+  ASSERT_TRUE(checkpoint::load(whole.partial_path, full, whole.checkpoint_settings()));
+  ASSERT_TRUE(checkpoint::load(cam.partial_path, crop, cam.checkpoint_settings()));
+  for (int j = 0; j < 24; j++) {
+    for (int i = 0; i < 24; i++) {
+      auto idx = full.index(i, j);
+      bool inside = i >= 6 && i < 12 && j >= 12;
+      ASSERT_EQ(crop.sample_count[idx], inside ? 6 : 0);
+      if (inside) {
+        ASSERT_EQ(crop.color_sum[idx].y(), full.color_sum[idx].y());
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include "../src/image_writer.h"
+#include "../src/rt_stb_image.h"
+
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+static image test_image(int width, int height) {
+  // Smooth gradients with a little noise, like a rendered image
+  image img(width, height);
+  uint32_t state = 12345;
+  for (int j = 0; j < height; j++) {
+    for (int i = 0; i < width; i++) {
+      state = state * 1664525u + 1013904223u;
+      float noise = 0.02f * ((state >> 8) / float(1 << 24) - 0.5f);
+      float* p = img.pixel(i, j);
+      p[0] = float(i) / width + noise;
+      p[1] = float(j) / height;
+      p[2] = 0.5f + 0.4f * sinf(0.05f * (i + j));
+    }
+  }
+  return img;
+}
+
+static string encode(const image_writer& writer, const image& img) {
+  ostringstream out;
+  EXPECT_TRUE(writer.write(out, img));
+  return out.str();
+}
+
+TEST(ImageWriterTest, pngroundtrip) {
+  // stb_image decodes exactly the bytes of the PPM
+  for (auto size : {pair<int, int>{1, 1}, {7, 3}, {200, 150}}) {
+    image img = test_image(size.first, size.second);
+    string png = encode(png_writer(), img);
+    auto expected = to_display_bytes(img);
+    int width, height, channels;
+    unsigned char* decoded = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(png.data()), static_cast<int>(png.size()),
+                                                   &width, &height, &channels, 3);
+    ASSERT_NE(decoded, nullptr) << stbi_failure_reason();
+    ASSERT_EQ(width, img.width);
+    ASSERT_EQ(height, img.height);
+    ASSERT_TRUE(equal(expected.begin(), expected.end(), decoded));
+    stbi_image_free(decoded);
+  }
+}
+
+TEST(ImageWriterTest, pngsize) {
+  // The PNG is compressed: far smaller than the PPM for smooth content, and a flat image is almost nothing
+  image img = test_image(400, 300);
+  string png = encode(png_writer(), img), ppm = encode(ppm_writer(), img);
+  EXPECT_LT(png.size(), ppm.size() / 2) << png.size() << " bytes PNG, " << ppm.size() << " bytes PPM";
+
+  image flat(400, 300);
+  EXPECT_LT(encode(png_writer(), flat).size(), ppm.size() / 100);
+}
+
+TEST(ImageWriterTest, adler32) {
+  string text = "Wikipedia";
+  EXPECT_EQ(deflate_encoder::adler32(vector<unsigned char>(text.begin(), text.end())), 0x11E60398u);
+  vector<unsigned char> large(100000, 255);
+  uint32_t a = 1, b = 0;
+  for (auto d : large) {
+    a = (a + d) % 65521;
+    b = (b + a) % 65521;
+  }
+  EXPECT_EQ(deflate_encoder::adler32(large), (b << 16) | a);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "../src/general.h"
+#include "../src/camera.h"
+#include "../src/hittable_list.h"
+#include "../src/material.h"
+#include "../src/quad.h"
+#include "../src/sphere.h"
+
+#include <fstream>
+
+TEST(LightAovTest, sumtest) {
+  // The light buffers add up to the image, each light (and the background) gets its own
+  auto red = make_shared<diffuse_light>(color(4, 0.5, 0.5));
+  auto blue = make_shared<diffuse_light>(color(0.5, 0.5, 4));
+  red->name = "red";
+  hittable_list world, lights;
+  world.add(make_shared<sphere>(point3(0, 0, 2), 0.5, make_shared<lambertian>(color(0.7, 0.7, 0.7))));
+  auto lamp_a = make_shared<quad>(point3(-1.5, 1, 1), vec3(1, 0, 0), vec3(0, 0, 1), red);
+  auto lamp_b = make_shared<quad>(point3(0.5, 1, 1), vec3(1, 0, 0), vec3(0, 0, 1), blue);
+  world.add(lamp_a);
+  world.add(lamp_b);
+  lights.add(lamp_a);
+  lights.add(lamp_b);
+
+  camera cam;
+  cam.image_width = 32;
+  cam.samples_per_pixel = 8;
+  cam.max_depth = 5;
+  cam.vfov = 60;
+  cam.lookfrom = point3(0, 0, -1);
+  cam.lookat = point3(0, 0, 2);
+  cam.background = color(0.1, 0.1, 0.1);
+  cam.output_path = "/tmp/light_aov_test.pfm";
+  cam.light_aov_path = "/tmp/light_aov_test";
+  cam.render(world, lights);
+
+  ifstream list("/tmp/light_aov_test.lights");
+  string name, path;
+  vector<string> names;
+  image sum(32, 32), beauty;
+  while (list >> name >> path) {
+    names.push_back(name);
+    image buffer;
+    ASSERT_TRUE(read_pfm(path, buffer));
+    for (size_t k = 0; k < sum.rgb.size(); k++) sum.rgb[k] += buffer.rgb[k];
+  }
+  ASSERT_EQ(names.size(), 3u);
+  ASSERT_NE(find(names.begin(), names.end(), "red"), names.end());
+  ASSERT_NE(find(names.begin(), names.end(), "background"), names.end());
+
+  ASSERT_TRUE(read_pfm(cam.output_path, beauty));
+  for (size_t k = 0; k < sum.rgb.size(); k++) ASSERT_NEAR(sum.rgb[k], beauty.rgb[k], 1e-4 * (1 + beauty.rgb[k]));
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "../src/general.h"
+
+TEST(SamplerTest, samestreamtest) {
+  sampler a, b;
+  a.start_pixel_sample(42, 7);
+  b.start_pixel_sample(42, 7);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(a.get_1d(), b.get_1d());
+  }
+}
+
+TEST(SamplerTest, dimensionjumptest) {
+  // Jumping to dimension 5 must give the same numbers as drawing 5 numbers first
+  sampler a, b;
+  a.start_pixel_sample(3, 1);
+  for (int i = 0; i < 5; i++) a.get_1d();
+  b.start_pixel_sample(3, 1);
+  b.start_dimension(5);
+  ASSERT_EQ(a.current_dimension(), b.current_dimension());
+  ASSERT_EQ(a.get_1d(), b.get_1d());
+}
+
+TEST(SamplerTest, distinctkeystest) {
+  sampler a;
+  a.start_pixel_sample(0, 0);
+  double pixel0 = a.get_1d();
+  a.start_pixel_sample(1, 0);
+  double pixel1 = a.get_1d();
+  a.start_pixel_sample(0, 1);
+  double sample1 = a.get_1d();
+  ASSERT_NE(pixel0, pixel1);
+  ASSERT_NE(pixel0, sample1);
+}
+
+TEST(SamplerTest, rangetest) {
+  sampler a;
+  a.start_pixel_sample(9, 9);
+  double sum = 0.0;
+  for (int i = 0; i < 100000; i++) {
+    double x = a.get_1d();
+    ASSERT_GE(x, 0.0);
+    ASSERT_LT(x, 1.0);
+    sum += x;
+  }
+  ASSERT_NEAR(sum / 100000, 0.5, 1.0e-2);
+}
+
+TEST(SamplerTest, stratifiedcellstest) {
+  // With 16 samples per pixel, the 16 points of a pair of dimensions land in 16 different cells of a 4x4 grid
+  sampler a;
+  a.pattern = sample_pattern::stratified;
+  a.samples_per_pixel = 16;
+  for (int dim = 0; dim < 6; dim += 2) {
+    bool taken[16] = {false};
+    for (int k = 0; k < 16; k++) {
+      a.start_pixel_sample(5, k);
+      a.start_dimension(dim);
+      double x = a.get_1d();
+      double y = a.get_1d();
+      int cell = static_cast<int>(4 * y) * 4 + static_cast<int>(4 * x);
+      ASSERT_FALSE(taken[cell]);
+      taken[cell] = true;
+    }
+  }
+}
+
+TEST(SamplerTest, sobolrangetest) {
+  sampler a;
+  a.pattern = sample_pattern::sobol;
+  for (int k = 0; k < 1000; k++) {
+    a.start_pixel_sample(11, k);
+    for (int dim = 0; dim < 40; dim++) {
+      double x = a.get_1d();
+      ASSERT_GE(x, 0.0);
+      ASSERT_LT(x, 1.0);
+    }
+  }
+}
+
+TEST(SamplerTest, patternconvergencetest) {
+  // Monte Carlo estimate of the integral of x*y over the unit square (= 1/4) with 64 samples, averaged over 200
+  // pixels: the stratified & sobol patterns have to beat independent samples by a wide margin
+  auto rms_error = [](sample_pattern pattern) {
+    sampler a;
+    a.pattern = pattern;
+    a.samples_per_pixel = 64;
+    double sum_sq = 0.0;
+    for (int pixel = 0; pixel < 200; pixel++) {
+      double estimate = 0.0;
+      for (int k = 0; k < 64; k++) {
+        a.start_pixel_sample(pixel, k);
+        a.start_dimension(2);
+        double x = a.get_1d();
+        double y = a.get_1d();
+        estimate += x * y / 64;
+      }
+      sum_sq += (estimate - 0.25) * (estimate - 0.25);
+    }
+    return sqrt(sum_sq / 200);
+  };
+  double independent = rms_error(sample_pattern::independent);
+  ASSERT_LT(rms_error(sample_pattern::stratified), independent / 4);
+  ASSERT_LT(rms_error(sample_pattern::sobol), independent / 4);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include "../src/scene_file.h"
+
+#include <cstdio>
+#include <fstream>
+
+static string write_scene(const string& name, const string& text) {
+  string path = "/tmp/" + name + ".scene";
+  ofstream(path) << text;
+  return path;
+}
+
+TEST(SceneFileTest, loadtest) {
+  auto path = write_scene("scene_file_test_load",
+    "# comment\n"
+    "camera width=64 spp=4 aspect_ratio=16/9 lookfrom=1,2,3\n"
+    "material white lambertian color=.73,.73,.73\n"
+    "material lamp light color=15,15,15\n"
+    "quad q=0,0,0 u=1,0,0 v=0,1,0 material=white\n"
+    "quad q=0,1,0 u=1,0,0 v=0,0,1 material=lamp   # sampled directly\n"
+    "sphere center=0,0,5 radius=1 material=lamp rotate_y=30\n");
+  scene_loader loader;
+  scene s;
+  ASSERT_TRUE(loader.load(path, s));
+  ASSERT_EQ(s.cam.image_width, 64);
+  ASSERT_EQ(s.cam.samples_per_pixel, 4);
+  ASSERT_DOUBLE_EQ(s.cam.aspect_ratio, 16.0 / 9.0);
+  ASSERT_EQ(s.cam.lookfrom.z(), 3);
+  ASSERT_EQ(s.world.objects.size(), 1u); // all three under one BVH
+  ASSERT_EQ(s.lights.objects.size(), 1u); // the transformed sphere is not sampled
+
+  hit_record rec;
+  ASSERT_TRUE(s.world.hit(ray(point3(0.5, 0.5, -1), vec3(0, 0, 1)), interval(0.001, infinity), rec));
+  ASSERT_DOUBLE_EQ(rec.t, 1.0);
+}
+
+TEST(SceneFileTest, cachetest) {
+  // Loading a file again reuses its objects, camera settings are applied every time
+  auto path = write_scene("scene_file_test_cache",
+    "camera spp=8\n"
+    "material white lambertian color=1,1,1\n"
+    "sphere center=0,0,0 radius=1 material=white\n");
+  scene_loader loader;
+  scene a, b;
+  ASSERT_TRUE(loader.load(path, a));
+  b.cam.samples_per_pixel = 1;
+  ASSERT_TRUE(loader.load(path, b));
+  ASSERT_EQ(b.cam.samples_per_pixel, 8);
+  ASSERT_EQ(a.world.objects[0], b.world.objects[0]);
+}
+
+TEST(SceneFileTest, errortest) {
+  scene_loader loader;
+  scene s;
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_e1", "sphere center=0,0,0 radius=1 material=none\n"), s));
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_e2", "material m metal color=1,1\n"), s));
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_e3", "camera spp=many\n"), s));
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_e4", "teapot size=1\n"), s));
+  ASSERT_FALSE(loader.load("/tmp/scene_file_test_missing.scene", s));
+  ASSERT_FALSE(scene_loader::set_option(s, "colour", "1"));
+}
+
+TEST(SceneFileTest, rangetest) {
+  // Values that would give an empty image or divide by zero are refused, with the file & line
+  scene_loader loader;
+  scene s;
+  testing::internal::CaptureStderr();
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_r1", "# sizes\ncamera width=0\n"), s));
+  string message = testing::internal::GetCapturedStderr();
+  ASSERT_NE(message.find("scene_file_test_r1.scene:2"), string::npos) << message;
+  ASSERT_NE(message.find("at least 1"), string::npos) << message;
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_r2", "camera spp=0\n"), s));
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_r3", "camera max_depth=-1\n"), s));
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_r4", "camera aspect_ratio=0\n"), s));
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_r5", "camera aspect_ratio=-16/9\n"), s));
+
+  s.cam.samples_per_pixel = 5;
+  ASSERT_FALSE(scene_loader::set_option(s, "spp", "0"));
+  ASSERT_EQ(s.cam.samples_per_pixel, 5);
+  ASSERT_FALSE(scene_loader::set_option(s, "tile_size", "0"));
+  ASSERT_TRUE(scene_loader::set_option(s, "threads", "0"));
+  ASSERT_TRUE(scene_loader::set_option(s, "width", "1"));
+}
+
+TEST(SceneFileTest, mediumtest) {
+  // The medium's parameters come before the boundary shape, the shape's after it
+  auto path = write_scene("scene_file_test_medium",
+    "material white lambertian color=1,1,1\n"
+    "medium density=0.5 color=1,1,1 box min=0,0,0 max=1,1,1 material=white translate=2,0,0\n");
+  scene_loader loader;
+  scene s;
+  ASSERT_TRUE(loader.load(path, s));
+  ASSERT_EQ(s.world.objects.size(), 1u);
+  ASSERT_NEAR(s.world.bounding_box().x.min, 2, 1e-3);
+}
+
+TEST(SceneFileTest, keyframetest) {
+  // Keyframed values are interpolated linearly, the animated sphere stays out of the static objects
+  auto path = write_scene("scene_file_test_keyframe",
+    "material white lambertian color=1,1,1\n"
+    "sphere center=0,0,0 radius=1 material=white name=ball translate=5,0,0\n"
+    "quad q=0,0,0 u=1,0,0 v=0,1,0 material=white name=still\n"
+    "frames 11\n"
+    "keyframe 0 ball translate=0,0,0\n"
+    "keyframe 10 ball translate=10,0,0\n"
+    "keyframe 0 camera lookfrom=0,0,-10 vfov=20\n"
+    "keyframe 10 camera lookfrom=0,0,-20 vfov=40\n");
+  scene_loader loader;
+  scene s;
+  ASSERT_TRUE(loader.load(path, s));
+  ASSERT_TRUE(s.anim);
+  ASSERT_EQ(s.anim->frame_count, 11);
+  ASSERT_EQ(s.world.objects.size(), 1u); // only the quad
+
+  scene f = s;
+  ASSERT_TRUE(scene_loader::set_frame(f, 3));
+  ASSERT_EQ(f.world.objects.size(), 2u);
+  ASSERT_DOUBLE_EQ(f.cam.lookfrom.z(), -13);
+  ASSERT_DOUBLE_EQ(f.cam.vfov, 26);
+  ASSERT_NEAR(f.world.bounding_box().x.max, 4, 1e-3);
+  ASSERT_EQ(s.world.objects.size(), 1u); // the loaded scene is unchanged
+
+  scene e;
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_k1", "keyframe 0 nothing rotate_y=10\n"), e));
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_k2", "keyframe 0 camera spp=10\n"), e));
+  ASSERT_FALSE(loader.load(write_scene("scene_file_test_k3", "frames 5\nkeyframe 5 camera vfov=10\n"), e));
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#define RT_STATS
+#include "../src/general.h"
+#include "../src/bvh.h"
+#include "../src/mesh.h"
+#include "../src/sphere.h"
+#include "../src/material.h"
+
+#include <thread>
+
+TEST(StatsTest, countertest) {
+  auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+  hittable_list objects;
+  objects.add(make_shared<sphere>(point3(0, 0, -5), 1.0, mat));
+  objects.add(make_shared<sphere>(point3(10, 0, -5), 1.0, mat));
+  bvh_node tree(objects);
+
+  render_stats::reset();
+  hit_record rec;
+  ASSERT_TRUE(tree.hit(ray(point3(0, 0, 0), vec3(0, 0, -1)), interval(0.001, infinity), rec));
+  ASSERT_FALSE(tree.hit(ray(point3(0, 0, 0), vec3(0, 1, 0)), interval(0.001, infinity), rec));
+
+  auto t = render_stats::total();
+  ASSERT_EQ(t[render_stats::sphere_hits], 1u);
+  ASSERT_GE(t[render_stats::sphere_tests], 1u);
+  ASSERT_GE(t[render_stats::bvh_nodes], 2u);
+  ASSERT_EQ(t[render_stats::aabb_tests], t[render_stats::bvh_nodes]); // every node tests its box once
+}
+
+TEST(StatsTest, triangletest) {
+  // triangle shares quad::hit, but is counted on its own
+  auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+  triangle tri(point3(-1, -1, -2), vec3(2, 0, 0), vec3(0, 2, 0), mat);
+
+  render_stats::reset();
+  hit_record rec;
+  ASSERT_TRUE(tri.hit(ray(point3(-0.5, -0.5, 0), vec3(0, 0, -1)), interval(0.001, infinity), rec));
+  auto t = render_stats::total();
+  ASSERT_EQ(t[render_stats::triangle_tests], 1u);
+  ASSERT_EQ(t[render_stats::triangle_hits], 1u);
+  ASSERT_EQ(t[render_stats::quad_tests], 0u);
+}
+
+TEST(StatsTest, threadtest) {
+  // Counts of threads that are already gone still show up in the total
+  render_stats::reset();
+  std::thread a([] { for (int i = 0; i < 1000; i++) RT_STAT(camera_rays); });
+  std::thread b([] { for (int i = 0; i < 500; i++) RT_STAT(camera_rays); });
+  a.join();
+  b.join();
+  ASSERT_EQ(render_stats::total()[render_stats::camera_rays], 1500u);
+  render_stats::reset();
+  ASSERT_EQ(render_stats::total().rays(), 0u);
+
+  // and the blocks of exited threads are given back, however many threads come and go
+  size_t blocks = render_stats::thread_blocks();
+  for (int k = 0; k < 200; k++) {
+    std::thread t([] { RT_STAT(shadow_rays); });
+    t.join();
+  }
+  ASSERT_EQ(render_stats::thread_blocks(), blocks);
+  ASSERT_EQ(render_stats::total()[render_stats::shadow_rays], 200u);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}